@@ -15,10 +15,16 @@
 
 #include "hardware/i2c.h"
 #include "hardware/gpio.h"
+#include "hardware/sync.h"
 #include "pico/time.h"
 
 #endif
 
+#include "mcp23017_debouncer.h"
+#include "mcp23017_io_policy.h"
+#include "mcp23017_stats.h"
+#include "mcp23017_transport.h"
+
 //#define DEBUG_MCP23017
 #ifdef  DEBUG_MCP23017
 #define mcp_debug(fmt, arg...) \
@@ -29,9 +35,75 @@
 #define mcp_debug(...) do { } while (false)
 #endif
 
+//#define STATS_MCP23017
+#ifdef  STATS_MCP23017
+#define mcp_stats(...) \
+	do {               \
+		__VA_ARGS__;   \
+	} while (0)
+#else
+#define mcp_stats(...) do { } while (false)
+#endif
+
+#define MCP23017_REGISTER_COUNT 0x16 //IODIRA (0x00) to OLATB (0x15) in IOCON.BANK=0 layout
+
+#ifndef MCP23017_STREAM_CHUNK_WORDS
+#define MCP23017_STREAM_CHUNK_WORDS 32 //words staged per transfer by Mcp23017::stream_output, 2 bytes of stack each
+#endif
+
+struct Mcp23017_transaction;
+class Mcp23017_transaction_queue;
+
+/**
+ * Called once a queued transaction has finished, from the I2C interrupt on the Pico so keep it short
+ */
+typedef void (*mcp23017_transaction_callback)(Mcp23017_transaction &transaction, void *context);
+
+/**
+ * Given each chunk of samples read by Mcp23017::stream_input, the bus is held until it returns so keep it short
+ * @param samples GPIOB<<8 | GPIOA for each sample, in order
+ * @param count number of samples
+ * @param started_us time_us_64 before the chunk was read, when the previous chunk finished
+ * @param finished_us time_us_64 once the chunk was read
+ */
+typedef void (*mcp23017_input_stream_handler)(const uint16_t *samples, size_t count, uint64_t started_us,
+											  uint64_t finished_us, void *context);
+
+/**
+ * Interrupt details read from INTFA to GPIOB in a single transaction by Mcp23017::service_interrupt
+ */
+struct Mcp23017_interrupt_state {
+	uint16_t flags; //INTF '1' bits are the pins that caused the interrupt
+	uint16_t captured; //INTCAP pin values at the time of the interrupt
+	uint16_t inputs; //GPIO pin values now
+};
+
+/**
+ * Full device configuration, written by Mcp23017::apply in a single transaction
+ * Defaults match the power on reset state of the device
+ */
+struct Mcp23017_config {
+	uint16_t io_direction{0xffff}; //IODIR '1' bits input, '0' bits output
+	uint16_t input_polarity{}; //IPOL '1' bits read inverted
+	uint16_t interrupt_enable{}; //GPINTEN '1' bits enable
+	uint16_t default_value{}; //DEFVAL compared against when interrupt_control is set
+	uint16_t interrupt_control{}; //INTCON '1' bits compare to default_value, '0' bits compare to previous values
+	uint16_t pullup{}; //GPPU '1' bits enable
+	bool mirroring{}; //IOCON.MIRROR INT pins internally connected
+	bool polarity{}; //IOCON.INTPOL true = active-high, false = active-low
+	bool open_drain{}; //IOCON.ODR INT pins open drain, overrides polarity
+	bool sequential{true}; //IOCON.SEQOP clear, address pointer increments
+	bool slew_rate{true}; //IOCON.DISSLW clear, SDA slew rate control enabled
+};
+
 /**
  * MCP23017 I/O Expander, 16bit
  *
+ * Keeps a shadow copy of the register file so that writes which would not change the device are skipped
+ *
+ * Blocking transfers follow the io policy: each has a deadline and failed operations are retried. A bus failure
+ * is returned as the negative MCP23017_ERROR_TIMEOUT, MCP23017_ERROR_NACK or MCP23017_ERROR_BUS_STUCK, NACK being
+ * the value of PICO_ERROR_GENERIC.
  */
 class Mcp23017 {
 
@@ -46,31 +118,59 @@ public:
 	 */
 	Mcp23017(i2c_inst_t *i2c,  uint8_t _address);
 
+	/**
+	 * Create a MCP23017 controller reached through a transport, such as Mcp23017_linux_transport
+	 *
+	 * Note: The non-blocking calls need a pico i2c bus and are not available, get_i2c returns nullptr
+	 *
+	 * @param _transport the bus, must outlive the controller
+	 * @param _address address on the bus
+	 */
+	Mcp23017(Mcp23017_transport &_transport, uint8_t _address);
+
 	/**
 	 * Configure with a IOCON (I/O Expander configuration register)
+	 * Other IOCON settings previously written, such as sequential operation, are kept
 	 *
 	 * @param mirroring true if you want the INT pins to be internally connected, allows you to save IO lines needed for detecting interrupts
 	 * @param polarity the polarity of the interrupt, true = active-high, false = active-low
-	 * @return PICO_ERROR_NONE or PICO_ERROR_GENERIC
+	 * @return PICO_ERROR_NONE or a negative MCP23017_ERROR_*
+	 */
+	int setup(bool mirroring, bool polarity);
+
+	/**
+	 * Writes the whole configuration, IODIRA to GPPUB, in one transaction
+	 * Only the span of registers that differ from the cached values is sent, nothing if all match
+	 * Note: relies on sequential operation, the power on default, IOCON is written first if it is known to be disabled
+	 * @param config the configuration
+	 * @return PICO_ERROR_NONE or a negative MCP23017_ERROR_*
 	 */
-	int setup(bool mirroring, bool polarity) const;
+	int apply(const Mcp23017_config &config);
 
 	/**
 	 * Gets the first pin that has changed values within the last interrupt, not 100% reliable
-	 * @return pin 0-15 or PICO_ERROR_GENERIC
+	 * @return pin 0-15, PICO_ERROR_GENERIC if no pin is flagged or a negative MCP23017_ERROR_*
 	 */
 	int get_last_interrupt_pin() const;
 
 	/**
 	 * Gets the values of all interrupts for client code interrogation
-	 * @return values or PICO_ERROR_GENERIC
+	 * @return values or a negative MCP23017_ERROR_*
 	 */
 	int get_interrupt_values() const;
 
+	/**
+	 * Reads the interrupt flags, captured values and current inputs in one transaction, clearing the interrupt
+	 * The inputs are stored as for update_and_get_input_values
+	 * @param state filled with the values read
+	 * @return PICO_ERROR_NONE or a negative MCP23017_ERROR_*
+	 */
+	int service_interrupt(Mcp23017_interrupt_state &state);
+
 	/**
 	 * Stores and returns the last input state in the class for later interrogation with
 	 * get_last_input_pin_value or get_last_input_pin_values
-	 * @return the pin values or PICO_ERROR_NONE or PICO_ERROR_GENERIC
+	 * @return PICO_ERROR_NONE or a negative MCP23017_ERROR_*
 	 */
 	int update_and_get_input_values();
 
@@ -87,54 +187,171 @@ public:
 	 */
 	uint16_t get_last_input_pin_values() const;
 
+	/**
+	 * Sets how many consecutive input samples must agree before the debounced state changes
+	 * Every stored input snapshot (update_and_get_input_values, service_interrupt, polling) is a sample
+	 * @param depth 1-15, 1 (the default) follows the raw inputs
+	 */
+	void set_debounce_depth(uint8_t depth);
+
+	/**
+	 * Returns all the debounced pin states
+	 * @return the pin values
+	 */
+	[[nodiscard]] uint16_t get_debounced_input_pin_values() const;
+
+	/**
+	 * Checks a pin's debounced state
+	 * @param pin the pin to query
+	 * @return the pin's state
+	 */
+	[[nodiscard]] bool get_debounced_input_pin_value(int pin) const;
+
+	/**
+	 * Returns the pins whose debounced state changed with the last input snapshot
+	 * @return '1' bits changed
+	 */
+	[[nodiscard]] uint16_t get_debounced_changed_mask() const;
+
 	/**
 	 * Gets the address we were constructed to talk to
 	 * @return the address
 	 */
 	[[nodiscard]] int get_address() const;
 
+	/**
+	 * Gets the bus we were constructed to talk on
+	 * @return the bus
+	 */
+	[[nodiscard]] i2c_inst_t *get_i2c() const;
+
+	/**
+	 * Gets the transport every blocking transfer is made through
+	 */
+	[[nodiscard]] Mcp23017_transport &get_transport() const;
+
+	/**
+	 * Sets the deadline and retry policy used by every blocking transfer
+	 * @param policy the policy, copied
+	 */
+	void set_io_policy(const Mcp23017_io_policy &policy);
+
+	[[nodiscard]] const Mcp23017_io_policy &get_io_policy() const;
+
+	/**
+	 * Gets the longest a single register read can take under the io policy, a write is bounded by less
+	 * Methods that make several transfers, setup and apply, can take a multiple of this
+	 * @return time in microseconds
+	 */
+	[[nodiscard]] uint32_t get_worst_case_latency_us() const;
+
+	/**
+	 * Copies the bus activity counted since construction or the last reset, needs STATS_MCP23017
+	 * @param snapshot filled with the counts, zeroed if stats are not compiled in
+	 * @return true if stats are compiled in
+	 */
+	bool get_stats(Mcp23017_stats &snapshot) const;
+
+	/**
+	 * Zeroes the bus activity counts
+	 */
+	void reset_stats();
+
 	/**
 	 * Sets the IO direction for each pin
 	 * @param direction '1' bits input, '0' bits output
-	 * @return PICO_ERROR_NONE or PICO_ERROR_GENERIC
+	 * @return PICO_ERROR_NONE or a negative MCP23017_ERROR_*
 	 */
-	int set_io_direction(int direction) const;
+	int set_io_direction(int direction);
 
 	/**
 	 * Sets the pull-up resistors for the pins (100K)
 	 * @param direction '1' bits enable, '0' bits disable
-	 * @return PICO_ERROR_NONE or PICO_ERROR_GENERIC
+	 * @return PICO_ERROR_NONE or a negative MCP23017_ERROR_*
 	 */
-	int set_pullup(int direction) const;
+	int set_pullup(int direction);
 
 	/**
 	 * Sets the interrupt control register
 	 * @param compare_to_reg '1' bits compare to default values, '0' bits compare to previous values
-	 * @return PICO_ERROR_NONE or PICO_ERROR_GENERIC
+	 * @return PICO_ERROR_NONE or a negative MCP23017_ERROR_*
 	 */
-	int set_interrupt_type(int compare_to_reg) const;
+	int set_interrupt_type(int compare_to_reg);
 
 	/**
 	 * Sets the interrupt enabled register
 	 * @param enabled '1' bits enable, '0' bits disable
-	 * @return PICO_ERROR_NONE or PICO_ERROR_GENERIC
+	 * @return PICO_ERROR_NONE or a negative MCP23017_ERROR_*
 	 */
-	int enable_interrupt(int enabled) const;
+	int enable_interrupt(int enabled);
 
 	/**
 	 * Sets all the output bits at once, also stores this as the internal state for later per pin manipulation with set_output_bit_for_pin
 	 * @param all_bits '1' bits on, '0' bits off
-	 * @return PICO_ERROR_NONE or PICO_ERROR_GENERIC
+	 * @return PICO_ERROR_NONE or a negative MCP23017_ERROR_*
 	 */
 	int set_all_output_bits(int all_bits);
 
 	/**
-	 * Sets an individual pin's within the internal state, this must be flushed to take effect
+	 * Sets an individual pin's within the internal state, this must be flushed to take effect, other pins are ignored
 	 * @param pin the pin 0-15
 	 * @param set true = on, false = off
 	 */
 	void set_output_bit_for_pin(int pin, bool set);
 
+	/**
+	 * Turns pins on within the internal state, safe to call from either core, this must be flushed to take effect
+	 * @param mask '1' bits are the pins to turn on
+	 */
+	void set_bits(uint16_t mask);
+
+	/**
+	 * Turns pins off within the internal state, safe to call from either core, this must be flushed to take effect
+	 * @param mask '1' bits are the pins to turn off
+	 */
+	void clear_bits(uint16_t mask);
+
+	/**
+	 * Inverts pins within the internal state, safe to call from either core, this must be flushed to take effect
+	 * @param mask '1' bits are the pins to invert
+	 */
+	void toggle_bits(uint16_t mask);
+
+	/**
+	 * Sets a group of pins within the internal state, safe to call from either core, this must be flushed to take effect
+	 * @param mask '1' bits are the pins to change
+	 * @param values '1' bits on, '0' bits off, bits outside the mask are ignored
+	 */
+	void write_bits(uint16_t mask, uint16_t values);
+
+	/**
+	 * Gets the whole internal output state
+	 * @return '1' bits on
+	 */
+	[[nodiscard]] uint16_t get_output_bits() const;
+
+	/**
+	 * Single core write_bits, inline and without output_lock so it is one AND/OR on the internal state
+	 * Only for when no other core changes or flushes this device's outputs
+	 */
+	void write_bits_unlocked(uint16_t mask, uint16_t values) {
+		output = (output & ~mask) | (values & mask);
+	}
+
+	/**
+	 * Single core toggle_bits, inline and without output_lock, see write_bits_unlocked
+	 */
+	void toggle_bits_unlocked(uint16_t mask) {
+		output ^= mask;
+	}
+
+	/**
+	 * Single core get_output_bits, inline and without output_lock, see write_bits_unlocked
+	 */
+	[[nodiscard]] uint16_t get_output_bits_unlocked() const {
+		return static_cast<uint16_t>(output);
+	}
+
 	/**
 	 * Check the state of an individual pin within the internal state
 	 * @param pin the pin 0-15
@@ -143,13 +360,162 @@ public:
 	bool get_output_bit_for_pin(int pin) const;
 
 	/**
-	 * Flushes the internal output state to the device
-	 * @return PICO_ERROR_NONE or PICO_ERROR_GENERIC
+	 * Flushes the internal output state to the device, only the ports that changed since the last flush are written
+	 * Inside a deferred flush this only leaves the output marked dirty, it is written when the deferral ends
+	 * @return PICO_ERROR_NONE or a negative MCP23017_ERROR_*
+	 */
+	int flush_output();
+
+	/**
+	 * Flushes the internal output state straight away, even inside a deferred flush
+	 *
+	 * Safe to call from either core. A flush requested while the other core is flushing is merged into that flush,
+	 * which writes again with the latest state before it returns, so this returns without waiting for the bus.
+	 *
+	 * @return PICO_ERROR_NONE or a negative MCP23017_ERROR_*, PICO_ERROR_NONE when merged into a flush on the other core
+	 */
+	int flush_output_immediate();
+
+	/**
+	 * Checks if some bits of the internal output state have been written to the device
+	 * @param mask the bits to check
+	 * @return true if the device latches match the internal state for those bits
 	 */
-	int flush_output() const;
+	[[nodiscard]] bool is_output_flushed(uint16_t mask) const;
+
+	/**
+	 * Starts deferring flushes so that changes from several outputs are written together, may be nested
+	 */
+	void begin_deferred_flush();
+
+	/**
+	 * Ends a deferral, the outermost end writes any changed output in a single flush
+	 * @return PICO_ERROR_NONE or a negative MCP23017_ERROR_*
+	 */
+	int end_deferred_flush();
+
+	/**
+	 * Clocks a sequence of output words out to OLATA/OLATB as one long write, for multiplexed displays, steppers and
+	 * other waveforms paced by the bus
+	 *
+	 * The device is put in byte mode (IOCON.SEQOP) so that the address pointer toggles between OLATA and OLATB, each
+	 * word then costs 2 bytes, 18 SCL clocks, and takes effect as its port B byte is acknowledged. Words are staged
+	 * MCP23017_STREAM_CHUNK_WORDS at a time with a repeated start between chunks, the bus is held until the last word.
+	 * Sequential operation is restored afterwards unless byte mode was already configured. Failures are not retried.
+	 *
+	 * Note: don't flush from the other core while streaming, the output state holds the last word afterwards
+	 * @param words output words, '1' bits on
+	 * @param count number of words
+	 * @return PICO_ERROR_NONE or a negative MCP23017_ERROR_*
+	 */
+	int stream_output(const uint16_t *words, size_t count);
+
+	/**
+	 * Reads the inputs over and over as one long read, for dense input traces
+	 *
+	 * As for stream_output the device is put in byte mode, here the address pointer toggles between GPIOA and GPIOB,
+	 * so each sample costs 2 bytes. Samples are read MCP23017_STREAM_CHUNK_WORDS at a time with a repeated start
+	 * between chunks and passed to the handler. The last sample of each chunk is stored as for
+	 * update_and_get_input_values. Failures are not retried.
+	 *
+	 * @param count number of samples
+	 * @param handler called with each chunk
+	 * @param context passed to the handler
+	 * @return PICO_ERROR_NONE or a negative MCP23017_ERROR_*
+	 */
+	int stream_input(size_t count, mcp23017_input_stream_handler handler, void *context);
+
+	/**
+	 * Scans a switch matrix with rows on port A and columns on port B, the bus is held from the first row to the last
+	 *
+	 * Each row's drive is written to GPIOA and GPIOB is read straight after with a repeated start, the address
+	 * pointer having moved on to GPIOB, so a row costs 2 transfers and 3 bytes. Failures are not retried.
+	 *
+	 * @param row_drives the port A value for each row
+	 * @param columns filled with the port B value read for each row
+	 * @param rows number of rows
+	 * @return PICO_ERROR_NONE or a negative MCP23017_ERROR_*
+	 */
+	int scan_matrix(const uint8_t *row_drives, uint8_t *columns, size_t rows);
+
+	/**
+	 * Sets the queue used for the non-blocking calls, it must be for the same i2c bus
+	 * @param queue the queue or nullptr
+	 */
+	void set_transaction_queue(Mcp23017_transaction_queue *queue);
+
+	/**
+	 * Queues a read of consecutive registers, the values are in transaction.data when the callback is made
+	 * @param transaction caller owned descriptor, not to be reused until the callback
+	 * @param reg the first register
+	 * @param length number of registers
+	 * @param callback called on completion, may be nullptr
+	 * @param context passed to the callback
+	 * @return PICO_ERROR_NONE or PICO_ERROR_GENERIC if it couldn't be queued
+	 */
+	int read_registers_async(Mcp23017_transaction &transaction, uint8_t reg, uint8_t length,
+							 mcp23017_transaction_callback callback, void *context);
+
+	/**
+	 * Queues a write of consecutive registers, the register cache is updated when the callback is made
+	 * @param transaction caller owned descriptor, not to be reused until the callback
+	 * @param reg the first register
+	 * @param values the values to write
+	 * @param length number of registers
+	 * @param callback called on completion, may be nullptr
+	 * @param context passed to the callback
+	 * @return PICO_ERROR_NONE or PICO_ERROR_GENERIC if it couldn't be queued
+	 */
+	int write_registers_async(Mcp23017_transaction &transaction, uint8_t reg, const uint8_t *values, uint8_t length,
+							  mcp23017_transaction_callback callback, void *context);
+
+	/**
+	 * Non-blocking update_and_get_input_values, the input values are stored when the callback is made
+	 * @return PICO_ERROR_NONE or PICO_ERROR_GENERIC if it couldn't be queued
+	 */
+	int update_input_values_async(Mcp23017_transaction &transaction, mcp23017_transaction_callback callback, void *context);
+
+	/**
+	 * Non-blocking flush_output, always writes both ports
+	 * @return PICO_ERROR_NONE or PICO_ERROR_GENERIC if it couldn't be queued
+	 */
+	int flush_output_async(Mcp23017_transaction &transaction, mcp23017_transaction_callback callback, void *context);
+
+	/**
+	 * Forgets what is known about the device registers, call after the chip has been reset
+	 * Registers previously written are kept as dirty so resync_registers can restore them
+	 */
+	void invalidate_registers();
+
+	/**
+	 * Writes every dirty register back to the device, contiguous registers share a single transaction
+	 * @return PICO_ERROR_NONE or a negative MCP23017_ERROR_*
+	 */
+	int resync_registers();
+
+	/**
+	 * Checks if the cached copy of a register is known to match the device
+	 * @param reg the register 0x00-0x15
+	 * @return true if valid
+	 */
+	[[nodiscard]] bool is_register_valid(uint8_t reg) const;
+
+	/**
+	 * Checks if a register holds a value that has not yet reached the device
+	 * @param reg the register 0x00-0x15
+	 * @return true if dirty
+	 */
+	[[nodiscard]] bool is_register_dirty(uint8_t reg) const;
 
 private:
-	int setup_bank_configuration(int reg, bool mirroring, bool polarity) const;
+	friend class Mcp23017_transaction_queue;
+	friend class Mcp23017_bus;
+
+	void transaction_complete(Mcp23017_transaction &transaction);
+
+	void store_input_values(uint16_t values);
+
+	int setup_bank_configuration(int reg, bool mirroring, bool polarity);
 
 	int write_register(uint8_t reg, uint8_t value) const;
 
@@ -157,13 +523,60 @@ private:
 
 	int read_dual_registers(uint8_t reg) const;
 
+	int read_registers(uint8_t reg, uint8_t *buffer, size_t length) const;
+
+	int transfer(uint8_t reg, const uint8_t *src, uint8_t *dst, size_t length) const;
+
+	int transfer_once(uint8_t reg, const uint8_t *src, uint8_t *dst, size_t length) const;
+
+	int retry_transfer(uint8_t reg, const uint8_t *src, uint8_t *dst, size_t length, int result) const;
+
+#ifdef STATS_MCP23017
+	void record_operation(uint8_t reg, bool read, int result, uint32_t started_us) const;
+#endif
+
 	int write_dual_registers(uint8_t reg, int value) const;
 
+	int write_cached_register(uint8_t reg, uint8_t value);
+
+	int write_cached_dual_registers(uint8_t reg, int value);
+
+	int write_cached_registers(uint8_t reg, const uint8_t *values, size_t length);
+
+	void cache_register(uint8_t reg, uint8_t value);
+
+	void mark_register_written(uint8_t reg, bool written);
+
+	void modify_output(uint16_t keep, uint16_t invert);
+
+	int write_output(int value);
+
+	int write_stream_chunk(const uint16_t *words, size_t count, bool last);
+
+	int begin_byte_mode(bool &restore);
+
+	int end_byte_mode(bool restore, int result);
+
 private:
 	i2c_inst_t *i2c;
+	mutable Mcp23017_pico_transport pico_transport;
+	Mcp23017_transport *transport{}; //nullptr for pico_transport
 	const uint8_t address;
-	int output{};
+	int output{}; //changed under output_lock
+	bool flush_pending{};
+	bool flushing{};
+	spin_lock_t *output_lock;
 	int last_input{};
+	Mcp23017_debouncer<uint16_t> debouncer;
+	uint8_t registers[MCP23017_REGISTER_COUNT]{};
+	uint32_t registers_valid{};
+	uint32_t registers_dirty{};
+	Mcp23017_transaction_queue *transaction_queue{};
+	int deferred_flush_depth{};
+	Mcp23017_io_policy io_policy;
+#ifdef STATS_MCP23017
+	mutable Mcp23017_stats stats{};
+#endif
 };
 
 #endif // PICO_MCP23017_H
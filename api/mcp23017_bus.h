@@ -0,0 +1,79 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MCP23017_BUS_H
+#define MCP23017_BUS_H
+
+#include "mcp23017.h"
+
+#define MCP23017_BUS_MAX_DEVICES 8 //addresses 0x20-0x27
+#define MCP23017_BUS_FIRST_ADDRESS 0x20
+
+/**
+ * All of the MCP23017s on one i2c bus, polled and flushed together
+ */
+class Mcp23017_bus {
+public:
+	/**
+	 * Create a manager for the specified i2c bus, the bus is expected to be already initialised
+	 * @param i2c selected bus
+	 */
+	explicit Mcp23017_bus(i2c_inst_t *i2c);
+
+	/**
+	 * Create a manager for the devices reached through a transport
+	 * @param transport the bus
+	 */
+	explicit Mcp23017_bus(const Mcp23017_transport &transport);
+
+	/**
+	 * Adds a device, its index in the snapshot is the order it was added in
+	 * @param mcp the device, must be on this bus and outlive the manager
+	 * @return the device index or PICO_ERROR_GENERIC if full, on another bus or already added
+	 */
+	int add_device(Mcp23017 &mcp);
+
+	/**
+	 * Reads the inputs of every device back to back using repeated starts, with a single stop at the end
+	 * The values are stored in the snapshot and in each device as for update_and_get_input_values
+	 * Each transfer has the device io policy deadline, a device that fails is retried on its own under that policy
+	 * @return PICO_ERROR_NONE or the error of a device that failed, the others are still read
+	 */
+	int poll_all();
+
+	/**
+	 * Flushes the output of every device, devices without changes are skipped
+	 * @return PICO_ERROR_NONE or the error of a device that failed, the others are still flushed
+	 */
+	int flush_all();
+
+	/**
+	 * Gets the inputs read by the last poll_all, one entry per device in the order they were added
+	 * @return the snapshot array of get_device_count() entries
+	 */
+	[[nodiscard]] const uint16_t *get_snapshot() const;
+
+	/**
+	 * Gets the number of devices added
+	 * @return the count
+	 */
+	[[nodiscard]] int get_device_count() const;
+
+	/**
+	 * Gets a device by index
+	 * @param index the index returned from add_device
+	 * @return the device or nullptr
+	 */
+	[[nodiscard]] Mcp23017 *get_device(int index) const;
+
+private:
+	const void *bus; //the get_bus() of the devices' transports
+	Mcp23017 *devices[MCP23017_BUS_MAX_DEVICES]{};
+	uint16_t snapshot[MCP23017_BUS_MAX_DEVICES]{};
+	int device_count{};
+};
+
+#endif //MCP23017_BUS_H
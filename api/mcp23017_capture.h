@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MCP23017_CAPTURE_H
+#define MCP23017_CAPTURE_H
+
+#include "mcp23017.h"
+#include "mcp23017_event_ring.h"
+
+/**
+ * An input sample, or a run of identical samples, taken by Mcp23017_capture
+ */
+struct Mcp23017_capture_sample {
+	uint64_t timestamp_us; //time_us_64 when the sample, the first of a run, was read
+	uint16_t inputs; //'1' bits high
+	uint16_t count; //samples in the run, 1 without run length compression
+};
+
+/**
+ * Logic analyser mode, reads a device's inputs back to back with Mcp23017::stream_input into a caller's ring
+ *
+ * Timestamps are spread evenly across each chunk as the bus clocks the samples at a steady rate. With run length
+ * compression consecutive identical samples are stored once with their count, runs don't span captures.
+ *
+ * @tparam Capacity of the ring, a power of two
+ */
+template<uint32_t Capacity>
+class Mcp23017_capture {
+public:
+	/**
+	 * @param _mcp the device to sample, its pins should already be inputs
+	 * @param _ring filled with samples, drained by the caller, possibly from the other core
+	 * @param _run_length true to merge consecutive identical samples
+	 */
+	Mcp23017_capture(Mcp23017 &_mcp, Mcp23017_ring<Mcp23017_capture_sample, Capacity> &_ring, bool _run_length = false)
+			: mcp(_mcp), ring(_ring), run_length(_run_length) {
+	}
+
+	/**
+	 * Takes samples as fast as the bus allows, blocking until done
+	 * Samples that don't fit in the ring are dropped and counted by the ring's overflow count
+	 * @param samples number of samples to read
+	 * @return PICO_ERROR_NONE or the negative MCP23017_ERROR_* from Mcp23017::stream_input, the samples read before
+	 * the failure are kept
+	 */
+	int capture(size_t samples) {
+		int result = mcp.stream_input(samples, on_samples, this);
+		end_run();
+		return result;
+	}
+
+	/**
+	 * Gets the number of samples read since construction, each sample of a run counts
+	 */
+	[[nodiscard]] uint32_t get_sample_count() const {
+		return sample_count;
+	}
+
+private:
+	static void on_samples(const uint16_t *samples, size_t count, uint64_t started_us, uint64_t finished_us,
+						   void *context) {
+		auto capture = static_cast<Mcp23017_capture *>(context);
+		uint64_t elapsed_us = finished_us - started_us;
+		for (size_t i = 0; i < count; i++) {
+			capture->add(samples[i], started_us + elapsed_us * (i + 1) / count);
+		}
+	}
+
+	void add(uint16_t inputs, uint64_t timestamp_us) {
+		sample_count++;
+		if (run_length && run.count > 0 && run.inputs == inputs && run.count < UINT16_MAX) {
+			run.count++;
+			return;
+		}
+		end_run();
+		run = {timestamp_us, inputs, 1};
+		if (!run_length) {
+			end_run();
+		}
+	}
+
+	void end_run() {
+		if (run.count > 0) {
+			ring.push(run);
+			run.count = 0;
+		}
+	}
+
+	Mcp23017 &mcp;
+	Mcp23017_ring<Mcp23017_capture_sample, Capacity> &ring;
+	const bool run_length;
+	Mcp23017_capture_sample run{};
+	uint32_t sample_count{};
+};
+
+#endif //MCP23017_CAPTURE_H
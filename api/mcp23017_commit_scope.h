@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MCP23017_COMMIT_SCOPE_H
+#define MCP23017_COMMIT_SCOPE_H
+
+#include <initializer_list>
+#include "mcp23017.h"
+#include "mcp23017_bus.h"
+
+#define MCP23017_COMMIT_SCOPE_MAX_DEVICES 16
+
+/**
+ * Defers output flushes on a set of devices for its lifetime, then writes each changed device once
+ *
+ * Any Output_switch built on these devices can be changed inside the scope, its flushes only mark state dirty.
+ * Use Mcp23017::flush_output_immediate for a write that can't wait.
+ * A latching output's coil pulse is one of those, desired_state_achieved writes the pulse out immediately when it
+ * has not reached the device yet, flushing any other deferred changes on that device with it.
+ *
+ * {
+ *     Mcp23017_commit_scope commit({&mcp0, &mcp1});
+ *     light.set_output_state(true);
+ *     fan.set_output_state(false);
+ * } //one flush per changed device here
+ */
+class Mcp23017_commit_scope {
+public:
+	explicit Mcp23017_commit_scope(Mcp23017 &mcp);
+
+	/**
+	 * @param devices up to MCP23017_COMMIT_SCOPE_MAX_DEVICES devices, the rest are not deferred
+	 */
+	Mcp23017_commit_scope(std::initializer_list<Mcp23017 *> devices);
+
+	/**
+	 * Defers every device on the bus
+	 */
+	explicit Mcp23017_commit_scope(const Mcp23017_bus &bus);
+
+	~Mcp23017_commit_scope();
+
+	Mcp23017_commit_scope(const Mcp23017_commit_scope &) = delete;
+
+	Mcp23017_commit_scope &operator=(const Mcp23017_commit_scope &) = delete;
+
+	/**
+	 * Ends the scope early so the result of the flushes can be checked, the destructor then does nothing
+	 * @return PICO_ERROR_NONE or the error of a device that failed, the others are still flushed
+	 */
+	int commit();
+
+private:
+	void add(Mcp23017 *mcp);
+
+	Mcp23017 *devices[MCP23017_COMMIT_SCOPE_MAX_DEVICES]{};
+	int device_count{};
+	bool committed{};
+};
+
+#endif //MCP23017_COMMIT_SCOPE_H
@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MCP23017_DEBOUNCER_H
+#define MCP23017_DEBOUNCER_H
+
+#include <cstdint>
+
+#define MCP23017_DEBOUNCE_MAX_DEPTH 15
+
+/**
+ * Bit-parallel debouncer using vertical counters
+ *
+ * Each bit of the word has a 4 bit counter spread across the count planes, counting consecutive samples that
+ * differ from the stable state. When a counter reaches the depth the stable bit flips. Every pin is handled by the
+ * same few word operations per plane, so the cost doesn't depend on the number of pins.
+ *
+ * @tparam Word unsigned type holding one bit per input, uint16_t for a device, wider for matrices or several devices
+ */
+template<typename Word>
+class Mcp23017_debouncer {
+public:
+	/**
+	 * @param depth consecutive differing samples needed to change state 1-15, 1 follows the input directly
+	 */
+	explicit Mcp23017_debouncer(uint8_t depth = 1) {
+		set_depth(depth);
+	}
+
+	/**
+	 * Changes the depth, counts in progress are restarted
+	 * @param depth consecutive differing samples needed to change state 1-15
+	 */
+	void set_depth(uint8_t _depth) {
+		depth = _depth < 1 ? 1 : (_depth > MCP23017_DEBOUNCE_MAX_DEPTH ? MCP23017_DEBOUNCE_MAX_DEPTH : _depth);
+		planes = 0;
+		while ((depth >> planes) != 0) {
+			planes++;
+		}
+		for (auto &plane : count) {
+			plane = 0;
+		}
+	}
+
+	[[nodiscard]] uint8_t get_depth() const {
+		return depth;
+	}
+
+	/**
+	 * Feeds a new sample, the first sample after construction or reset is taken as stable straight away
+	 * @param sample the raw input bits
+	 * @return bits whose stable state changed with this sample
+	 */
+	Word update(Word sample) {
+		if (!seeded) {
+			stable = sample;
+			seeded = true;
+			changed = 0;
+			return changed;
+		}
+		Word delta = sample ^ stable;
+		Word carry = delta;
+		Word reached = delta;
+		for (uint8_t i = 0; i < planes; i++) {
+			Word plane = count[i];
+			count[i] = (plane ^ carry) & delta;
+			carry &= plane;
+			reached &= ((depth >> i) & 1) ? count[i] : static_cast<Word>(~count[i]);
+		}
+		for (uint8_t i = 0; i < planes; i++) {
+			count[i] &= static_cast<Word>(~reached);
+		}
+		stable ^= reached;
+		changed = reached;
+		return changed;
+	}
+
+	/**
+	 * Forgets the stable state, the next sample is taken as stable
+	 */
+	void reset() {
+		seeded = false;
+		stable = 0;
+		changed = 0;
+		for (auto &plane : count) {
+			plane = 0;
+		}
+	}
+
+	[[nodiscard]] Word get_stable() const {
+		return stable;
+	}
+
+	/**
+	 * Bits whose stable state changed with the last sample
+	 */
+	[[nodiscard]] Word get_changed() const {
+		return changed;
+	}
+
+private:
+	Word count[4]{};
+	Word stable{};
+	Word changed{};
+	uint8_t depth{1};
+	uint8_t planes{1};
+	bool seeded{};
+};
+
+#endif //MCP23017_DEBOUNCER_H
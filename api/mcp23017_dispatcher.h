@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MCP23017_DISPATCHER_H
+#define MCP23017_DISPATCHER_H
+
+#include "mcp23017.h"
+
+#define MCP23017_DISPATCHER_MAX_MASK_HANDLERS 8
+
+typedef void (*mcp23017_pin_handler)(Mcp23017 &mcp, int pin, bool value, void *context);
+
+typedef void (*mcp23017_mask_handler)(Mcp23017 &mcp, uint16_t changed, uint16_t values, void *context);
+
+/**
+ * Works out every pin that changed between input snapshots and calls the handlers registered for them
+ *
+ * Only the changed pins are visited, so several pins flipping together are all reported and unchanged pins cost nothing
+ */
+class Mcp23017_dispatcher {
+public:
+	explicit Mcp23017_dispatcher(Mcp23017 &mcp);
+
+	/**
+	 * Registers the handler for a single pin, replacing any previous one
+	 * @param pin the pin 0-15
+	 * @param handler called with the pin's new value, nullptr to remove
+	 * @param context passed to the handler
+	 * @return PICO_ERROR_NONE or PICO_ERROR_GENERIC if the pin is out of range
+	 */
+	int on_pin(int pin, mcp23017_pin_handler handler, void *context);
+
+	/**
+	 * Registers a handler called once per dispatch when any pin in the mask changed
+	 * @param mask '1' bits of interest
+	 * @param handler called with the changed pins within the mask and all the values
+	 * @param context passed to the handler
+	 * @return PICO_ERROR_NONE or PICO_ERROR_GENERIC if there is no room
+	 */
+	int on_mask(uint16_t mask, mcp23017_mask_handler handler, void *context);
+
+	/**
+	 * Reads the inputs and dispatches the pins that differ from the previous snapshot
+	 * @return PICO_ERROR_NONE or the device's negative MCP23017_ERROR_* with nothing dispatched
+	 */
+	int poll();
+
+	/**
+	 * Services an interrupt and dispatches the pins flagged in INTF as well as any that differ from the previous snapshot
+	 * @return PICO_ERROR_NONE or the device's negative MCP23017_ERROR_* with nothing dispatched
+	 */
+	int service_interrupt();
+
+	/**
+	 * Calls the handlers for the changed pins
+	 * @param changed '1' bits changed
+	 * @param values the current values of all pins
+	 */
+	void dispatch(uint16_t changed, uint16_t values);
+
+private:
+	struct Pin_handler {
+		mcp23017_pin_handler handler;
+		void *context;
+	};
+
+	struct Mask_handler {
+		uint16_t mask;
+		mcp23017_mask_handler handler;
+		void *context;
+	};
+
+	Mcp23017 &_mcp;
+	Pin_handler pin_handlers[16]{};
+	uint16_t pins_with_handlers{};
+	Mask_handler mask_handlers[MCP23017_DISPATCHER_MAX_MASK_HANDLERS]{};
+	int mask_handler_count{};
+};
+
+#endif //MCP23017_DISPATCHER_H
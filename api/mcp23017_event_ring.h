@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MCP23017_EVENT_RING_H
+#define MCP23017_EVENT_RING_H
+
+#include <atomic>
+#include "mcp23017.h"
+
+/**
+ * Single producer, single consumer lock-free ring buffer
+ *
+ * One side (typically an interrupt handler) pushes and the other (the main loop) pops, neither blocks
+ *
+ * @tparam T the element type
+ * @tparam Capacity number of elements, a power of two
+ */
+template<typename T, uint32_t Capacity>
+class Mcp23017_ring {
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+	/**
+	 * Adds an element, producer side only
+	 * @return false if full, the element is dropped and counted
+	 */
+	bool push(const T &value) {
+		uint32_t head = write_index.load(std::memory_order_relaxed);
+		if (head - read_index.load(std::memory_order_acquire) == Capacity) {
+			overflow_count.store(overflow_count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			return false;
+		}
+		elements[head & (Capacity - 1)] = value;
+		write_index.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	/**
+	 * Removes the oldest element, consumer side only
+	 * @return false if empty
+	 */
+	bool pop(T &value) {
+		uint32_t tail = read_index.load(std::memory_order_relaxed);
+		if (tail == write_index.load(std::memory_order_acquire)) {
+			return false;
+		}
+		value = elements[tail & (Capacity - 1)];
+		read_index.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	[[nodiscard]] uint32_t size() const {
+		return write_index.load(std::memory_order_acquire) - read_index.load(std::memory_order_acquire);
+	}
+
+	[[nodiscard]] bool empty() const {
+		return size() == 0;
+	}
+
+	/**
+	 * Gets the number of elements dropped because the ring was full
+	 */
+	[[nodiscard]] uint32_t get_overflow_count() const {
+		return overflow_count.load(std::memory_order_relaxed);
+	}
+
+private:
+	T elements[Capacity]{};
+	std::atomic<uint32_t> write_index{0};
+	std::atomic<uint32_t> read_index{0};
+	std::atomic<uint32_t> overflow_count{0};
+};
+
+/**
+ * An interrupt edge from a device, recorded in the interrupt handler and serviced from the main loop
+ */
+struct Mcp23017_interrupt_event {
+	Mcp23017 *device;
+	uint64_t timestamp_us; //time_us_64 when the edge was recorded
+	bool serviced; //true if the state below was read, false if service_interrupt failed
+	Mcp23017_interrupt_state state;
+};
+
+typedef void (*mcp23017_interrupt_event_handler)(const Mcp23017_interrupt_event &event, void *context);
+
+/**
+ * Timestamped record of interrupt edges so that none are lost between main loop iterations
+ *
+ * @tparam Capacity number of events that can be pending, a power of two
+ */
+template<uint32_t Capacity>
+class Mcp23017_interrupt_ring {
+public:
+	/**
+	 * Records an edge, safe to call from the gpio interrupt callback
+	 * @param device the device whose INT line fired
+	 * @return false if the ring was full and the event was dropped
+	 */
+	bool record(Mcp23017 &device) {
+		return ring.push({&device, time_us_64(), false, {}});
+	}
+
+	/**
+	 * Services each recorded event in order with service_interrupt and passes it to the handler, main loop only
+	 * @param handler called for each event
+	 * @param context passed to the handler
+	 * @return number of events handled
+	 */
+	int drain(mcp23017_interrupt_event_handler handler, void *context) {
+		int handled = 0;
+		Mcp23017_interrupt_event event{};
+		while (ring.pop(event)) {
+			event.serviced = event.device->service_interrupt(event.state) == PICO_ERROR_NONE;
+			handler(event, context);
+			handled++;
+		}
+		return handled;
+	}
+
+	[[nodiscard]] uint32_t pending() const {
+		return ring.size();
+	}
+
+	[[nodiscard]] uint32_t get_overflow_count() const {
+		return ring.get_overflow_count();
+	}
+
+private:
+	Mcp23017_ring<Mcp23017_interrupt_event, Capacity> ring;
+};
+
+#endif //MCP23017_EVENT_RING_H
@@ -18,7 +18,7 @@ public:
 
 private:
 	Mcp23017 &_mcp_detect;
-	int _detect_pin;
+	uint16_t _detect_mask;
 };
 
 #endif //MCP23017_INPUT_H
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MCP23017_IO_POLICY_H
+#define MCP23017_IO_POLICY_H
+
+#ifdef MOCK_PICO_PI
+#include "../test/pico_pi_mocks.h"
+#else
+#include "pico/types.h"
+#include "pico/error.h"
+#endif
+
+#define MCP23017_ERROR_TIMEOUT PICO_ERROR_TIMEOUT //the transfer didn't complete before its deadline
+#define MCP23017_ERROR_NACK PICO_ERROR_GENERIC //the device didn't acknowledge its address or the data
+#define MCP23017_ERROR_BUS_STUCK (-64) //SDA still held low after bus recovery, outside the pico sdk error range
+
+#define MCP23017_DEFAULT_TIMEOUT_US 10000
+#define MCP23017_RECOVERY_CLOCKS 9
+#define MCP23017_RECOVERY_HALF_PERIOD_US 5 //100kHz, slow enough for any device on the bus
+#define MCP23017_RECOVERY_MAX_US ((MCP23017_RECOVERY_CLOCKS * 2 + 3) * MCP23017_RECOVERY_HALF_PERIOD_US)
+#define MCP23017_NO_GPIO (-1)
+
+/**
+ * Deadline and retry settings for the blocking transfers of a device
+ *
+ * The defaults give every transfer a deadline and don't retry.
+ */
+struct Mcp23017_io_policy {
+	uint32_t timeout_us{MCP23017_DEFAULT_TIMEOUT_US}; //deadline for each i2c call, a register read makes two
+	uint8_t retries{}; //further attempts after a failure, the whole operation is repeated
+	uint32_t backoff_us{100}; //wait before the first retry, doubled for each one after
+	uint32_t max_backoff_us{2000}; //limit on the doubled wait
+	int sda_gpio{MCP23017_NO_GPIO}; //with scl_gpio, enables bus recovery before retrying after a timeout
+	int scl_gpio{MCP23017_NO_GPIO};
+};
+
+/**
+ * Frees a bus where a slave holds SDA low, having lost a clock part way through a byte
+ *
+ * The pins are taken from the i2c peripheral, SCL is clocked up to 9 times until SDA is released, then a stop is sent
+ * and the pins are handed back to the i2c peripheral. The lines are only ever pulled low or released to the pull ups,
+ * never driven high, so a slave stretching the clock isn't fought. Takes at most MCP23017_RECOVERY_MAX_US.
+ *
+ * @param sda_gpio the SDA pin of the bus
+ * @param scl_gpio the SCL pin of the bus
+ * @return PICO_ERROR_NONE or MCP23017_ERROR_BUS_STUCK
+ */
+int mcp23017_recover_bus(uint sda_gpio, uint scl_gpio);
+
+/**
+ * Waits out the backoff before a retry, then frees the bus if the failure was a timeout and the policy has its pins
+ * @param policy the policy in use
+ * @param retry 0 for the first retry
+ * @param result the error of the failed attempt
+ * @return PICO_ERROR_NONE to retry or MCP23017_ERROR_BUS_STUCK
+ */
+int mcp23017_prepare_retry(const Mcp23017_io_policy &policy, int retry, int result);
+
+/**
+ * Gets the longest a single bus operation can take under a policy, including every retry, backoff and recovery
+ * @param policy the policy in use
+ * @param transfers i2c calls in the operation, 1 for a register write, 2 for a register read
+ * @return time in microseconds
+ */
+uint32_t mcp23017_worst_case_latency_us(const Mcp23017_io_policy &policy, int transfers);
+
+#endif //MCP23017_IO_POLICY_H
@@ -8,20 +8,28 @@
 #define MCP23017_LATCHING_OUTPUT_H
 
 #include "mcp23017.h"
+#include "mcp23017_latching_scheduler.h"
 #include "output_switch.h"
 
 class Mcp23017_latching_output : public Output_switch {
 public:
 	Mcp23017_latching_output(Mcp23017 &mcp, int off, int on);
 
+	/**
+	 * Create an output whose coil pulses are timed by the scheduler, desired_state_achieved is then not needed
+	 */
+	Mcp23017_latching_output(Mcp23017 &mcp, int off, int on, Mcp23017_latching_scheduler &scheduler);
+
 	void set_output_state(bool desired_state) override;
 
 	void desired_state_achieved() override;
 
 private:
 	Mcp23017 &_mcp_out;
-	int _off_pin;
-	int _on_pin;
+	uint16_t _off_mask;
+	uint16_t _on_mask;
+	Mcp23017_latching_scheduler *_scheduler{};
+	int _relay{PICO_ERROR_GENERIC};
 };
 
 #endif //MCP23017_LATCHING_OUTPUT_H
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MCP23017_LATCHING_SCHEDULER_H
+#define MCP23017_LATCHING_SCHEDULER_H
+
+#include "mcp23017.h"
+
+#define MCP23017_SCHEDULER_MAX_RELAYS 64
+#define MCP23017_SCHEDULER_MAX_DEVICES 16
+
+/**
+ * Drives the coils of many latching relays, releasing them after the pulse width without the caller's involvement
+ *
+ * Work is done in ticks, every relay edge that falls due in a tick is staged first and then each device that
+ * changed is flushed once, so switching many relays on one device at once costs one write per edge.
+ */
+class Mcp23017_latching_scheduler {
+public:
+	/**
+	 * @param pulse_width_us how long the coil is driven for
+	 */
+	explicit Mcp23017_latching_scheduler(uint32_t pulse_width_us);
+
+	/**
+	 * Adds a relay
+	 * @param mcp the device the coils are on, must outlive the scheduler
+	 * @param off_pin pin driving the off (reset) coil
+	 * @param on_pin pin driving the on (set) coil
+	 * @return the relay index or PICO_ERROR_GENERIC if full or the pins are out of range
+	 */
+	int add_relay(Mcp23017 &mcp, int off_pin, int on_pin);
+
+	/**
+	 * Requests a relay to switch, its pulse starts on the next tick
+	 * A request made while the relay is still pulsing starts once that pulse has been released
+	 * Safe to call while the timer from start is running
+	 * @param relay index from add_relay
+	 * @param state true = on, false = off
+	 * @return PICO_ERROR_NONE or PICO_ERROR_GENERIC for an unknown relay
+	 */
+	int request(int relay, bool state);
+
+	/**
+	 * Releases the coils whose pulses have ended and starts the requested pulses, one flush per changed device
+	 * @param now_us the current time, from time_us_64
+	 * @return PICO_ERROR_NONE or PICO_ERROR_GENERIC if any flush failed
+	 */
+	int tick(uint64_t now_us);
+
+	/**
+	 * Stages the relay edges from a repeating timer, the timer never touches the bus so service must be called
+	 * from the main loop to flush them. A pulse is timed from the service call that writes it, so late service
+	 * calls lengthen pulses rather than losing them.
+	 * @param tick_us the timer period, pulses are rounded up to whole ticks
+	 * @return true if the timer was started
+	 */
+	bool start(uint32_t tick_us);
+
+	/**
+	 * Flushes the devices the timer has staged edges for, call from the main loop while the timer runs
+	 * @return PICO_ERROR_NONE or PICO_ERROR_GENERIC if any flush failed
+	 */
+	int service();
+
+	/**
+	 * Stops the repeating timer
+	 */
+	void stop();
+
+	/**
+	 * Checks if no pulses are pending or in progress
+	 * @return true if idle
+	 */
+	[[nodiscard]] bool is_idle() const;
+
+private:
+	struct Relay {
+		Mcp23017 *mcp;
+		uint8_t device;
+		uint16_t off_mask;
+		uint16_t on_mask;
+		bool requested;
+		bool requested_state;
+		bool pulsing;
+		bool set_written; //the pulse has reached the device, release_at_us is valid
+		uint64_t release_at_us;
+	};
+
+	static bool timer_callback(repeating_timer_t *timer);
+	uint32_t stage(uint64_t now_us);
+	int flush_devices(uint32_t devices_changed, uint64_t now_us);
+
+	uint32_t pulse_width_us;
+	Relay relays[MCP23017_SCHEDULER_MAX_RELAYS]{};
+	int relay_count{};
+	Mcp23017 *devices[MCP23017_SCHEDULER_MAX_DEVICES]{};
+	int device_count{};
+	volatile uint32_t pending_devices{}; //staged by the timer, flushed by service
+	repeating_timer_t timer{};
+	bool timer_running{};
+};
+
+#endif //MCP23017_LATCHING_SCHEDULER_H
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MCP23017_LINUX_TRANSPORT_H
+#define MCP23017_LINUX_TRANSPORT_H
+
+#ifdef __linux__
+
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#include "mcp23017.h"
+
+#define MCP23017_LINUX_HELD_MAX (1 + 2 * MCP23017_STREAM_CHUNK_WORDS) //longest nostop write held for the next transfer
+
+/**
+ * Linux /dev/i2c-N transport, for running the driver on Linux boards
+ *
+ * i2c-dev can't keep the bus between calls, so a write made with nostop is held back and sent together with the
+ * next transfer as one I2C_RDWR combined message. A register write and read then go out with a repeated start
+ * between them, as they do on the Pico. An error in a held write is returned by the transfer it was sent with.
+ * Reads can't be held as their data is needed straight away, so a read always ends with a stop, even with nostop.
+ * Back to back reads, as in Mcp23017::stream_input, then each start a new transfer.
+ *
+ * The deadline of each transfer sets the adapter timeout, which Linux keeps in 10ms units.
+ */
+class Mcp23017_linux_transport : public Mcp23017_transport {
+public:
+	Mcp23017_linux_transport() = default;
+
+	~Mcp23017_linux_transport() override;
+
+	Mcp23017_linux_transport(const Mcp23017_linux_transport &) = delete;
+
+	Mcp23017_linux_transport &operator=(const Mcp23017_linux_transport &) = delete;
+
+	/**
+	 * Opens /dev/i2c-N
+	 * @param bus N, the adapter number
+	 * @return PICO_ERROR_NONE or PICO_ERROR_GENERIC
+	 */
+	int open(int bus);
+
+	/**
+	 * Closes the device file, a held write is dropped
+	 */
+	void close();
+
+	[[nodiscard]] bool is_open() const;
+
+	int write(uint8_t address, const uint8_t *src, size_t length, bool nostop, uint32_t timeout_us) override;
+
+	int read(uint8_t address, uint8_t *dst, size_t length, bool nostop, uint32_t timeout_us) override;
+
+protected:
+	/**
+	 * Makes an ioctl on the device file, overridden to stand in for i2c-dev in tests
+	 * @return as ioctl, -1 with errno set on failure
+	 */
+	virtual int control(unsigned long request, unsigned long argument);
+
+private:
+	int transfer_with_held(i2c_msg &message, uint32_t timeout_us);
+
+	int send_held(uint32_t timeout_us);
+
+	int transfer(i2c_msg *messages, int count, uint32_t timeout_us);
+
+	int fd{-1};
+	uint32_t adapter_timeout_us{}; //last deadline given to I2C_TIMEOUT, 0 for not yet set
+	bool holding{};
+	uint8_t held_address{};
+	uint16_t held_length{};
+	uint8_t held[MCP23017_LINUX_HELD_MAX]{};
+};
+
+#endif //__linux__
+
+#endif //MCP23017_LINUX_TRANSPORT_H
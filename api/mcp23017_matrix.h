@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MCP23017_MATRIX_H
+#define MCP23017_MATRIX_H
+
+#include "mcp23017.h"
+#include "mcp23017_debouncer.h"
+#include "mcp23017_event_ring.h"
+
+#define MCP23017_MATRIX_MAX_ROWS 8
+#define MCP23017_MATRIX_MAX_COLUMNS 8
+#define MCP23017_MATRIX_EVENTS 32 //key events held until popped, a power of two
+
+/**
+ * Gets the key number used by Mcp23017_matrix, also its bit in the key words
+ * @param row 0-7, pin GPAn
+ * @param column 0-7, pin GPBn
+ */
+constexpr int mcp23017_key(int row, int column) {
+	return row * MCP23017_MATRIX_MAX_COLUMNS + column;
+}
+
+/**
+ * A key going down or up once debounced
+ */
+struct Mcp23017_key_event {
+	uint64_t timestamp_us; //time_us_64 at the end of the scan that saw it
+	uint8_t key; //mcp23017_key(row, column)
+	bool pressed;
+};
+
+/**
+ * Switch matrix scanner for up to 8x8 keys on one device, rows on port A and columns on port B
+ *
+ * Rows are outputs driven high, each in turn is driven low while the columns, inputs with pull-ups, are read. The
+ * whole scan is one bus hold with 2 transfers per row, an 8x8 scan takes around 0.95ms at 400 kHz. With fewer than 8
+ * rows the spare port A pins may be used as outputs once setup is done, each row drive keeps their output state.
+ *
+ * Without a diode per key, three keys at the corners of a rectangle make the fourth read as pressed. A scan where two
+ * rows share more than one pressed column is taken as ghosted and leaves the debounced state as it was.
+ */
+class Mcp23017_matrix {
+public:
+	/**
+	 * @param _mcp the device, must outlive the scanner
+	 * @param _rows number of rows from GPA0, 1-8
+	 * @param _columns number of columns from GPB0, 1-8
+	 */
+	Mcp23017_matrix(Mcp23017 &_mcp, uint8_t _rows = MCP23017_MATRIX_MAX_ROWS, uint8_t _columns = MCP23017_MATRIX_MAX_COLUMNS);
+
+	/**
+	 * Makes the rows outputs driven high and the columns inputs with pull-ups, other pins are left as inputs
+	 * @return PICO_ERROR_NONE or a negative MCP23017_ERROR_*
+	 */
+	int setup();
+
+	/**
+	 * Scans every row, debounces the keys and queues an event for each key that changed
+	 * Keys already down on the first scan are taken as the starting state without events
+	 * @return number of events queued or a negative MCP23017_ERROR_*
+	 */
+	int scan();
+
+	/**
+	 * Takes the oldest key event
+	 * @return false if there are none
+	 */
+	bool pop_event(Mcp23017_key_event &event);
+
+	/**
+	 * Sets how many consecutive scans must agree before a key changes
+	 * @param depth 1-15, 1 (the default) follows the raw scans
+	 */
+	void set_debounce_depth(uint8_t depth);
+
+	/**
+	 * Gets the debounced keys
+	 * @return bit mcp23017_key(row, column) set for each key down
+	 */
+	[[nodiscard]] uint64_t get_keys() const;
+
+	/**
+	 * Gets the keys seen by the last scan before debouncing, ghosts included
+	 */
+	[[nodiscard]] uint64_t get_raw_keys() const;
+
+	[[nodiscard]] bool is_pressed(int key) const;
+
+	/**
+	 * Checks if the last scan was ghosted and so ignored
+	 */
+	[[nodiscard]] bool is_ghosted() const;
+
+	/**
+	 * Gets the number of ghosted scans
+	 */
+	[[nodiscard]] uint32_t get_ghost_count() const;
+
+	/**
+	 * Gets the number of events dropped because they weren't popped in time
+	 */
+	[[nodiscard]] uint32_t get_overflow_count() const;
+
+private:
+	[[nodiscard]] bool has_ghost(const uint8_t *row_keys) const;
+
+	Mcp23017 &mcp;
+	const uint8_t rows;
+	const uint8_t row_mask;
+	const uint8_t column_mask;
+	uint8_t row_drives[MCP23017_MATRIX_MAX_ROWS]{};
+	Mcp23017_debouncer<uint64_t> debouncer;
+	Mcp23017_ring<Mcp23017_key_event, MCP23017_MATRIX_EVENTS> events;
+	uint64_t raw_keys{};
+	bool ghosted{};
+	uint32_t ghost_count{};
+};
+
+#endif //MCP23017_MATRIX_H
@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MCP23017_MUX_H
+#define MCP23017_MUX_H
+
+#include "mcp23017.h"
+#include "mcp23017_bus.h"
+
+#define MCP23017_MUX_CHANNELS 8
+#define MCP23017_MUX_DEFAULT_ADDRESS 0x70 //TCA9548A with A0,1,2 to GND
+#define MCP23017_MUX_MAX_DEVICES (MCP23017_MUX_CHANNELS * MCP23017_BUS_MAX_DEVICES)
+#define MCP23017_MUX_NO_CHANNEL (-1) //every channel disconnected
+#define MCP23017_MUX_UNKNOWN_CHANNEL (-2) //not yet selected, or the last select failed
+
+class Mcp23017_mux;
+
+/**
+ * One downstream channel of a mux, the transport for the devices wired to it
+ * Each transfer selects the channel first, unless it is already selected
+ */
+class Mcp23017_mux_channel : public Mcp23017_transport {
+public:
+	int write(uint8_t address, const uint8_t *src, size_t length, bool nostop, uint32_t timeout_us) override;
+
+	int read(uint8_t address, uint8_t *dst, size_t length, bool nostop, uint32_t timeout_us) override;
+
+	[[nodiscard]] int get_channel() const;
+
+private:
+	friend class Mcp23017_mux;
+
+	Mcp23017_mux *mux{};
+	int channel{};
+};
+
+/**
+ * TCA9548A i2c multiplexer, up to 8 MCP23017s on each of its 8 channels
+ *
+ * The selected channel is tracked so that a control register write is only made when a transfer is for a device on
+ * another channel. poll_all and flush_all go through the devices channel by channel, starting from the one already
+ * selected, so a pass over every device costs at most one select per channel in use.
+ */
+class Mcp23017_mux {
+public:
+	/**
+	 * Create a mux on the specified i2c bus, the bus is expected to be already initialised
+	 * @param i2c selected bus
+	 * @param _address mux address 0x70-0x77
+	 */
+	explicit Mcp23017_mux(i2c_inst_t *i2c, uint8_t _address = MCP23017_MUX_DEFAULT_ADDRESS);
+
+	/**
+	 * Create a mux reached through a transport
+	 * @param _upstream the bus the mux is on, must outlive it
+	 * @param _address mux address 0x70-0x77
+	 */
+	explicit Mcp23017_mux(Mcp23017_transport &_upstream, uint8_t _address = MCP23017_MUX_DEFAULT_ADDRESS);
+
+	Mcp23017_mux(const Mcp23017_mux &) = delete;
+
+	Mcp23017_mux &operator=(const Mcp23017_mux &) = delete;
+
+	/**
+	 * Gets the transport for the devices on a channel, to construct them with
+	 * @param channel 0-7, out of range values are clamped
+	 */
+	[[nodiscard]] Mcp23017_mux_channel &get_channel(int channel);
+
+	/**
+	 * Connects a channel, nothing is written if it is already the selected one
+	 * @param channel 0-7 or MCP23017_MUX_NO_CHANNEL
+	 * @param timeout_us deadline for the control register write
+	 * @return PICO_ERROR_NONE, PICO_ERROR_GENERIC for any other channel or a negative MCP23017_ERROR_*
+	 */
+	int select(int channel, uint32_t timeout_us = MCP23017_DEFAULT_TIMEOUT_US);
+
+	/**
+	 * Gets the channel last selected
+	 * @return 0-7, MCP23017_MUX_NO_CHANNEL or MCP23017_MUX_UNKNOWN_CHANNEL
+	 */
+	[[nodiscard]] int get_selected_channel() const;
+
+	/**
+	 * Forgets the selected channel, call after the mux has been reset, the next transfer selects again
+	 */
+	void invalidate_selection();
+
+	/**
+	 * Gets the number of control register writes made, for measuring the switching overhead
+	 */
+	[[nodiscard]] uint32_t get_select_count() const;
+
+	/**
+	 * Adds a device for poll_all and flush_all
+	 * @param mcp the device, constructed with one of this mux's channels, must outlive the mux
+	 * @return the device index or PICO_ERROR_GENERIC if full, on another bus or its address is already used on the channel
+	 */
+	int add_device(Mcp23017 &mcp);
+
+	/**
+	 * Reads the inputs of every device, channel by channel with the devices on a channel read back to back as for
+	 * Mcp23017_bus::poll_all, the values are stored in each device as for update_and_get_input_values
+	 * @return PICO_ERROR_NONE or the error of a device that failed, the others are still read
+	 */
+	int poll_all();
+
+	/**
+	 * Flushes the output of every device channel by channel, devices without changes don't select their channel
+	 * @return PICO_ERROR_NONE or the error of a device that failed, the others are still flushed
+	 */
+	int flush_all();
+
+	[[nodiscard]] int get_device_count() const;
+
+	/**
+	 * Gets a device by index
+	 * @param index the index returned from add_device
+	 * @return the device or nullptr
+	 */
+	[[nodiscard]] Mcp23017 *get_device(int index) const;
+
+private:
+	void init_channels();
+
+	[[nodiscard]] int find_channel(const Mcp23017 &mcp) const;
+
+	[[nodiscard]] int first_channel() const;
+
+	Mcp23017_pico_transport pico_transport;
+	Mcp23017_transport *upstream;
+	const uint8_t address;
+	Mcp23017_mux_channel channels[MCP23017_MUX_CHANNELS];
+	int selected{MCP23017_MUX_UNKNOWN_CHANNEL};
+	uint32_t select_count{};
+	Mcp23017 *devices[MCP23017_MUX_MAX_DEVICES]{};
+	int8_t device_channels[MCP23017_MUX_MAX_DEVICES]{};
+	int device_count{};
+
+	friend class Mcp23017_mux_channel;
+};
+
+#endif //MCP23017_MUX_H
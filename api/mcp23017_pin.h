@@ -0,0 +1,222 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MCP23017_PIN_H
+#define MCP23017_PIN_H
+
+#include <utility>
+#include "mcp23017.h"
+#include "mcp23017_private.h"
+
+/**
+ * How the handles reach a device's output state. By default through the locked calls, safe from either core, each an
+ * out of line read-modify-write under a hardware spin lock. With MCP23017_SINGLE_CORE_OUTPUTS defined for the whole
+ * build the unlocked inline calls are used instead, so each access compiles to a single AND/OR.
+ */
+struct Mcp23017_pin_output {
+	static void write(Mcp23017 &mcp, uint16_t mask, uint16_t values) {
+#ifdef MCP23017_SINGLE_CORE_OUTPUTS
+		mcp.write_bits_unlocked(mask, values);
+#else
+		mcp.write_bits(mask, values);
+#endif
+	}
+
+	static void toggle(Mcp23017 &mcp, uint16_t mask) {
+#ifdef MCP23017_SINGLE_CORE_OUTPUTS
+		mcp.toggle_bits_unlocked(mask);
+#else
+		mcp.toggle_bits(mask);
+#endif
+	}
+
+	static uint16_t read(const Mcp23017 &mcp) {
+#ifdef MCP23017_SINGLE_CORE_OUTPUTS
+		return mcp.get_output_bits_unlocked();
+#else
+		return mcp.get_output_bits();
+#endif
+	}
+};
+
+/**
+ * A single pin of a device, the pin is a template parameter so it is range checked by the compiler
+ * and every access is a mask operation with a constant mask, see Mcp23017_pin_output for its cost
+ *
+ * Mcp23017_pin<4> pump(mcp1);
+ * pump.set(true);
+ * mcp1.flush_output();
+ *
+ * @tparam Pin the pin 0-15, 0-7 GPA0-7, 8-15 GPB0-7
+ */
+template<int Pin>
+class Mcp23017_pin {
+	static_assert(Pin >= 0 && Pin <= 15, "MCP23017 pins are 0-15");
+
+public:
+	static constexpr int pin = Pin;
+	static constexpr uint16_t mask = 1u << Pin;
+
+	explicit constexpr Mcp23017_pin(Mcp23017 &_mcp) : mcp(_mcp) {
+	}
+
+	/**
+	 * Sets the pin within the device's output state, this must be flushed to take effect
+	 * @param on true = on, false = off
+	 */
+	void set(bool on) const {
+		Mcp23017_pin_output::write(mcp, mask, on ? mask : 0);
+	}
+
+	void toggle() const {
+		Mcp23017_pin_output::toggle(mcp, mask);
+	}
+
+	/**
+	 * Gets the pin from the device's output state
+	 */
+	[[nodiscard]] bool get_output() const {
+		return Mcp23017_pin_output::read(mcp) & mask;
+	}
+
+	/**
+	 * Gets the pin from the last values read from the device
+	 */
+	[[nodiscard]] bool get_input() const {
+		return mcp.get_last_input_pin_values() & mask;
+	}
+
+	/**
+	 * Gets the pin from the debounced input state
+	 */
+	[[nodiscard]] bool get_debounced_input() const {
+		return mcp.get_debounced_input_pin_values() & mask;
+	}
+
+	[[nodiscard]] Mcp23017 &get_device() const {
+		return mcp;
+	}
+
+private:
+	Mcp23017 &mcp;
+};
+
+/**
+ * A group of pins of a device read and written together as one masked operation, see Mcp23017_pin_output for its cost
+ *
+ * Values are either in device bit positions, masked to the group, or packed where bit n is the nth pin listed.
+ *
+ * Mcp23017_pin_group<3, 5, 6, 7> digit(mcp1);
+ * digit.write_packed(9); //pins 3 and 7 on, 5 and 6 off
+ * mcp1.flush_output();
+ *
+ * @tparam Pins the pins 0-15, each listed once
+ */
+template<int... Pins>
+class Mcp23017_pin_group {
+	static_assert(sizeof...(Pins) > 0, "a pin group needs at least one pin");
+	static_assert(((Pins >= 0 && Pins <= 15) && ...), "MCP23017 pins are 0-15");
+	static_assert(__builtin_popcount(((1u << Pins) | ...)) == sizeof...(Pins), "a pin is listed more than once");
+
+public:
+	static constexpr uint16_t mask = ((1u << Pins) | ...);
+	static constexpr int size = sizeof...(Pins);
+
+	explicit constexpr Mcp23017_pin_group(Mcp23017 &_mcp) : mcp(_mcp) {
+	}
+
+	/**
+	 * Converts packed values, bit n for the nth pin, to device bit positions
+	 */
+	static constexpr uint16_t unpack(uint16_t packed) {
+		return unpack(packed, std::make_index_sequence<sizeof...(Pins)>());
+	}
+
+	/**
+	 * Converts device bit positions to packed values, bit n for the nth pin
+	 */
+	static constexpr uint16_t pack(uint16_t values) {
+		return pack(values, std::make_index_sequence<sizeof...(Pins)>());
+	}
+
+	/**
+	 * Turns every pin of the group on within the device's output state, this must be flushed to take effect
+	 */
+	void set_all() const {
+		Mcp23017_pin_output::write(mcp, mask, mask);
+	}
+
+	void clear_all() const {
+		Mcp23017_pin_output::write(mcp, mask, 0);
+	}
+
+	void toggle_all() const {
+		Mcp23017_pin_output::toggle(mcp, mask);
+	}
+
+	/**
+	 * Sets the group within the device's output state, this must be flushed to take effect
+	 * @param values '1' bits on, in device bit positions, bits outside the group are ignored
+	 */
+	void write(uint16_t values) const {
+		Mcp23017_pin_output::write(mcp, mask, values);
+	}
+
+	/**
+	 * Sets the group within the device's output state, this must be flushed to take effect
+	 * @param packed bit n for the nth pin
+	 */
+	void write_packed(uint16_t packed) const {
+		Mcp23017_pin_output::write(mcp, mask, unpack(packed));
+	}
+
+	/**
+	 * Gets the group from the device's output state, in device bit positions
+	 */
+	[[nodiscard]] uint16_t get_output() const {
+		return Mcp23017_pin_output::read(mcp) & mask;
+	}
+
+	/**
+	 * Gets the group from the last values read from the device, in device bit positions
+	 */
+	[[nodiscard]] uint16_t get_input() const {
+		return mcp.get_last_input_pin_values() & mask;
+	}
+
+	/**
+	 * Gets the group from the last values read from the device, bit n for the nth pin
+	 */
+	[[nodiscard]] uint16_t get_input_packed() const {
+		return pack(mcp.get_last_input_pin_values());
+	}
+
+	/**
+	 * Gets the group from the debounced input state, in device bit positions
+	 */
+	[[nodiscard]] uint16_t get_debounced_input() const {
+		return mcp.get_debounced_input_pin_values() & mask;
+	}
+
+	[[nodiscard]] Mcp23017 &get_device() const {
+		return mcp;
+	}
+
+private:
+	template<size_t... Index>
+	static constexpr uint16_t unpack(uint16_t packed, std::index_sequence<Index...>) {
+		return static_cast<uint16_t>(((((packed >> Index) & 1u) << Pins) | ...));
+	}
+
+	template<size_t... Index>
+	static constexpr uint16_t pack(uint16_t values, std::index_sequence<Index...>) {
+		return static_cast<uint16_t>(((((values >> Pins) & 1u) << Index) | ...));
+	}
+
+	Mcp23017 &mcp;
+};
+
+#endif //MCP23017_PIN_H
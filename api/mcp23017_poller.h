@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MCP23017_POLLER_H
+#define MCP23017_POLLER_H
+
+#include "mcp23017.h"
+
+#define MCP23017_POLLER_MAX_DEVICES 16
+
+/**
+ * Called when a poll finds that the inputs of a device changed
+ * @param mcp the device, its last input values hold the new state
+ * @param changed '1' bits are the pins that changed
+ * @param context from set_handler
+ */
+typedef void (*mcp23017_poll_handler)(Mcp23017 &mcp, uint16_t changed, void *context);
+
+/**
+ * Polls the inputs of devices without their INT line wired, adapting each device's period to its activity
+ *
+ * A device whose inputs changed is polled again after the minimum period, each quiet poll doubles the period up to
+ * the maximum, or the device's latency target if lower. Idle devices then cost a read per maximum period while a
+ * burst of activity is followed at the minimum period from its first change.
+ */
+class Mcp23017_poller {
+public:
+	/**
+	 * @param min_period_us period while inputs are changing
+	 * @param max_period_us longest period for a quiet device
+	 */
+	Mcp23017_poller(uint32_t min_period_us, uint32_t max_period_us);
+
+	/**
+	 * Adds a device, first polled on the next call to poll
+	 * @param mcp the device, must outlive the poller
+	 * @param latency_target_us the longest a change may go unseen, lowers the maximum period, 0 for none
+	 * @return the device index or PICO_ERROR_GENERIC if full
+	 */
+	int add_device(Mcp23017 &mcp, uint32_t latency_target_us = 0);
+
+	/**
+	 * Sets a handler called for each device whose inputs changed
+	 * @param handler the handler, nullptr for none
+	 * @param context passed to the handler
+	 */
+	void set_handler(mcp23017_poll_handler handler, void *context);
+
+	/**
+	 * Reads the devices that are due and adjusts their periods
+	 * @param now_us the current time, from time_us_64
+	 * @return number of devices whose inputs changed or the error of a read that failed, the others are still read
+	 */
+	int poll(uint64_t now_us);
+
+	/**
+	 * Gets when the next device falls due, so that the caller can sleep until then
+	 * @return the time in the time_us_64 timebase
+	 */
+	[[nodiscard]] uint64_t get_next_poll_us() const;
+
+	/**
+	 * Gets the current period of a device
+	 * @param device index from add_device
+	 * @return the period in microseconds or 0 for an unknown device
+	 */
+	[[nodiscard]] uint32_t get_period_us(int device) const;
+
+	/**
+	 * Gets the number of reads made, for measuring bus load
+	 */
+	[[nodiscard]] uint32_t get_poll_count() const;
+
+	/**
+	 * Paces the polls from a repeating timer, the timer never touches the bus, it only marks that a poll is due so
+	 * that service, called from the main loop, does the reads and calls the handler
+	 * @param tick_us the timer period, periods are rounded up to whole ticks so keep it at or below the minimum
+	 * @return true if the timer was started
+	 */
+	bool start(uint32_t tick_us);
+
+	/**
+	 * Polls if the timer has ticked since the last call, call from the main loop while the timer runs
+	 * @return as for poll, 0 if no tick was pending
+	 */
+	int service();
+
+	/**
+	 * Stops the repeating timer
+	 */
+	void stop();
+
+private:
+	struct Device {
+		Mcp23017 *mcp;
+		uint32_t max_period_us;
+		uint32_t period_us;
+		uint64_t next_poll_us;
+		uint16_t previous;
+		bool seeded;
+	};
+
+	static bool timer_callback(repeating_timer_t *timer);
+
+	uint32_t min_period_us;
+	uint32_t max_period_us;
+	Device devices[MCP23017_POLLER_MAX_DEVICES]{};
+	int device_count{};
+	uint32_t poll_count{};
+	mcp23017_poll_handler handler{};
+	void *handler_context{};
+	repeating_timer_t timer{};
+	bool timer_running{};
+	volatile bool tick_pending{}; //set by the timer, cleared by service
+};
+
+#endif //MCP23017_POLLER_H
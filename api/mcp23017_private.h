@@ -7,16 +7,24 @@
 #ifndef MCP23017_PRIVATE_H
 #define MCP23017_PRIVATE_H
 
+#include <cstdint>
+
 #define MCP23017_IODIRA 0x00 //Direction of data I/O (bits set as: 1 = input, 0 = output)
 #define MCP23017_IODIRB 0x01 //Direction of data I/O (bits set as: 1 = input, 0 = output)
+#define MCP23017_IPOLA 0x02 //Input polarity (bits set as: 1 = inverted)
+#define MCP23017_IPOLB 0x03 //Input polarity (bits set as: 1 = inverted)
 #define MCP23017_GPINTENA 0x04 //Interrupt on change
 #define MCP23017_GPINTENB 0x05 //Interrupt on change
+#define MCP23017_DEFVALA 0x06 //Default compare value for interrupt on change
+#define MCP23017_DEFVALB 0x07 //Default compare value for interrupt on change
 #define MCP23017_INTCONA 0x08 //Interrupt on change control register
 #define MCP23017_INTCONB 0x09 //Interrupt on change control register
 #define MCP23017_GPPUA 0x0C //PullUp set internal pull up for input pins
 #define MCP23017_GPPUB 0x0D //PullUp set internal pull up for input pins
 #define MCP23017_GPIOA 0x12 //Port Register - write modifies latch
 #define MCP23017_GPIOB 0x13 //Port Register - write modifies latch
+#define MCP23017_OLATA 0x14 //Output Latch Register - read returns latch, not pin state
+#define MCP23017_OLATB 0x15 //Output Latch Register - read returns latch, not pin state
 
 #define MCP23017_IOCONA 0x0A //IO Configuration - BANK/MIRROR/SLEW/INTPOL
 #define MCP23017_IOCONB 0x0B //IO Configuration - BANK/MIRROR/SLEW/INTPOL
@@ -24,6 +32,7 @@
 #define MCP23017_INTFB 0x0F //Interrupt Flag
 #define MCP23017_INTCAPA 0x10 //Interrupt Capture
 #define MCP23017_INTCAPB 0x11 //Interrupt Capture
+#define MCP23017_CONFIG_REGISTER_COUNT 0x0E //IODIRA to GPPUB
 #define MCP23017_IOCON_BANK_BIT 7
 #define MCP23017_IOCON_MIRROR_BIT 6
 #define MCP23017_IOCON_SEQOP_BIT 5
@@ -49,4 +58,13 @@ inline bool is_bit_set(int value, int bit) {
 	return false;
 }
 
+/**
+ * Mask for a pin chosen at run time, computed once where the pin is stored rather than on each access
+ * @param pin the pin 0-15
+ * @return the mask or 0 if out of range
+ */
+constexpr uint16_t mcp23017_pin_mask(int pin) {
+	return pin >= 0 && pin <= 15 ? static_cast<uint16_t>(1u << pin) : 0;
+}
+
 #endif //MCP23017_PRIVATE_H
@@ -0,0 +1,48 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MCP23017_STATS_H
+#define MCP23017_STATS_H
+
+#include <cstdint>
+
+#define MCP23017_STATS_BUCKETS 16 //bucket 0 under 1us, bucket n from 2^(n-1)us, the last from 16.4ms up
+
+/**
+ * Kinds of bus operation, each has its own latency histogram
+ */
+enum Mcp23017_stats_operation {
+	MCP23017_STATS_READ_INPUT, //reads starting at GPIO
+	MCP23017_STATS_READ_INTERRUPT, //reads starting at INTF or INTCAP
+	MCP23017_STATS_READ_OTHER,
+	MCP23017_STATS_WRITE_OUTPUT, //writes starting at OLAT
+	MCP23017_STATS_WRITE_CONFIG, //every other write
+	MCP23017_STATS_OPERATIONS
+};
+
+/**
+ * Bus activity of a device, kept when STATS_MCP23017 is defined
+ */
+struct Mcp23017_stats {
+	uint32_t transactions; //i2c transfers attempted, a register read is two
+	uint32_t bytes; //bytes transferred including the register address, excluding the device address
+	uint32_t errors; //operations that failed once their retries ran out
+	uint32_t retries;
+	uint32_t skipped_writes; //writes not made as the device already held the values
+	uint32_t latency[MCP23017_STATS_OPERATIONS][MCP23017_STATS_BUCKETS]; //operations by time taken, retries included
+};
+
+/**
+ * Gets the histogram bucket for a latency
+ * @param latency_us time taken in microseconds
+ * @return bucket 0 to MCP23017_STATS_BUCKETS - 1
+ */
+inline int mcp23017_stats_bucket(uint32_t latency_us) {
+	int bucket = latency_us == 0 ? 0 : 32 - __builtin_clz(latency_us);
+	return bucket < MCP23017_STATS_BUCKETS ? bucket : MCP23017_STATS_BUCKETS - 1;
+}
+
+#endif //MCP23017_STATS_H
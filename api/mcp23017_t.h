@@ -0,0 +1,373 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MCP23017_T_H
+#define MCP23017_T_H
+
+#include "mcp23017.h"
+
+/**
+ * IOCON.BANK register layouts
+ */
+enum class Mcp23017_bank : uint8_t {
+	paired = 0, //BANK=0, A and B registers alternate so 16bit values are one sequential transfer
+	separate = 1, //BANK=1, each port's registers are contiguous so 8bit port transfers are shortest
+};
+
+enum class Mcp23017_port : uint8_t {
+	a = 0,
+	b = 1,
+};
+
+/**
+ * Registers in the order they appear within a port, shared by both layouts
+ */
+enum class Mcp23017_register : uint8_t {
+	iodir = 0,
+	ipol,
+	gpinten,
+	defval,
+	intcon,
+	iocon,
+	gppu,
+	intf,
+	intcap,
+	gpio,
+	olat,
+};
+
+/**
+ * Register address for the given layout, BANK=0 interleaves the ports, BANK=1 puts port B 0x10 higher
+ */
+constexpr uint8_t mcp23017_register_address(Mcp23017_bank bank, Mcp23017_register reg, Mcp23017_port port) {
+	return bank == Mcp23017_bank::paired
+		   ? static_cast<uint8_t>(static_cast<uint8_t>(reg) * 2 + static_cast<uint8_t>(port))
+		   : static_cast<uint8_t>(static_cast<uint8_t>(reg) + static_cast<uint8_t>(port) * 0x10);
+}
+
+static_assert(mcp23017_register_address(Mcp23017_bank::paired, Mcp23017_register::gpio, Mcp23017_port::b) == 0x13);
+static_assert(mcp23017_register_address(Mcp23017_bank::separate, Mcp23017_register::olat, Mcp23017_port::b) == 0x1a);
+
+/**
+ * MCP23017 I/O Expander, 16bit, with the address and register layout fixed at compile time
+ *
+ * Pin arguments are template parameters so they are range checked by the compiler and reduce to mask operations.
+ * Transfers go through a Mcp23017_transport under a Mcp23017_io_policy, the same as a Mcp23017.
+ *
+ * @tparam Address address on the bus 0x20-0x27
+ * @tparam Bank register layout to switch the device to in setup
+ */
+template<uint8_t Address, Mcp23017_bank Bank = Mcp23017_bank::paired>
+class Mcp23017T {
+	static_assert(Address >= 0x20 && Address <= 0x27, "MCP23017 addresses are 0x20-0x27");
+
+public:
+	static constexpr uint8_t address = Address;
+	static constexpr Mcp23017_bank bank = Bank;
+
+	/**
+	 * Gets a register address in this device's layout
+	 */
+	static constexpr uint8_t register_address(Mcp23017_register reg, Mcp23017_port port = Mcp23017_port::a) {
+		return mcp23017_register_address(Bank, reg, port);
+	}
+
+	/**
+	 * Create a MCP23017 controller on the specified i2c bus
+	 *
+	 * Note: The i2c bus is expected to be already initialised as it may be shared between multiple devices
+	 *
+	 * @param i2c selected bus
+	 */
+	explicit Mcp23017T(i2c_inst_t *_i2c) : pico_transport(_i2c) {
+	}
+
+	/**
+	 * Create a MCP23017 controller reached through a transport, such as Mcp23017_linux_transport
+	 *
+	 * @param _transport the bus, must outlive the controller
+	 */
+	explicit Mcp23017T(Mcp23017_transport &_transport) : pico_transport(nullptr), transport(&_transport) {
+	}
+
+	/**
+	 * Gets the transport every transfer is made through
+	 */
+	[[nodiscard]] Mcp23017_transport &get_transport() const {
+		return transport ? *transport : pico_transport;
+	}
+
+	/**
+	 * Sets the deadline and retries of every transfer
+	 */
+	void set_io_policy(const Mcp23017_io_policy &policy) {
+		io_policy = policy;
+	}
+
+	[[nodiscard]] const Mcp23017_io_policy &get_io_policy() const {
+		return io_policy;
+	}
+
+	/**
+	 * Gets the bus activity counts, operations are classed by register the same as a Mcp23017
+	 * @param snapshot filled with the counts, zeroed if stats are not compiled in
+	 * @return true if stats are compiled in
+	 */
+	bool get_stats(Mcp23017_stats &snapshot) const {
+#ifdef STATS_MCP23017
+		uint32_t status = save_and_disable_interrupts();
+		snapshot = stats;
+		restore_interrupts(status);
+		return true;
+#else
+		snapshot = {};
+		return false;
+#endif
+	}
+
+	/**
+	 * Zeroes the bus activity counts
+	 */
+	void reset_stats() {
+#ifdef STATS_MCP23017
+		uint32_t status = save_and_disable_interrupts();
+		stats = {};
+		restore_interrupts(status);
+#endif
+	}
+
+	/**
+	 * Configure IOCON, switching the device to this layout
+	 *
+	 * IOCON is written at 0x0B, which is IOCON with BANK=0 and unimplemented with BANK=1. With BANK=1 it is then
+	 * written again at 0x05, IOCON in that layout, so a device already switched by an earlier run is configured too.
+	 * A paired device can't do the same as 0x05 is GPINTENB with BANK=0, so a device left in BANK=1 needs a power
+	 * cycle or reset to return to BANK=0.
+	 *
+	 * @param mirroring true if you want the INT pins to be internally connected
+	 * @param polarity the polarity of the interrupt, true = active-high, false = active-low
+	 * @return PICO_ERROR_NONE or a negative MCP23017_ERROR_*
+	 */
+	int setup(bool mirroring, bool polarity) {
+		auto iocon = static_cast<uint8_t>((static_cast<uint8_t>(Bank) << 7) | (mirroring << 6) | (polarity << 1));
+		int result = write_register(0x0b, iocon);
+		if constexpr (Bank == Mcp23017_bank::separate) {
+			if (result == PICO_ERROR_NONE) {
+				result = write_register(register_address(Mcp23017_register::iocon), iocon);
+			}
+		}
+		return result;
+	}
+
+	template<Mcp23017_port Port>
+	int set_io_direction(uint8_t direction) {
+		return write_register(register_address(Mcp23017_register::iodir, Port), direction);
+	}
+
+	int set_io_direction(uint16_t direction) {
+		return write_pair(Mcp23017_register::iodir, direction);
+	}
+
+	int set_pullup(uint16_t enabled) {
+		return write_pair(Mcp23017_register::gppu, enabled);
+	}
+
+	int set_interrupt_type(uint16_t compare_to_reg) {
+		return write_pair(Mcp23017_register::intcon, compare_to_reg);
+	}
+
+	int enable_interrupt(uint16_t enabled) {
+		return write_pair(Mcp23017_register::gpinten, enabled);
+	}
+
+	/**
+	 * Reads one port's inputs, a single register read in either layout
+	 * @return the port value or a negative MCP23017_ERROR_*
+	 */
+	template<Mcp23017_port Port>
+	int update_port_input_values() {
+		uint8_t value;
+		int result = read_registers(register_address(Mcp23017_register::gpio, Port), &value, 1);
+		if (result < PICO_ERROR_NONE) {
+			return result;
+		}
+		constexpr int shift = Port == Mcp23017_port::a ? 0 : 8;
+		last_input = static_cast<uint16_t>((last_input & ~(0xff << shift)) | (value << shift));
+		return value;
+	}
+
+	/**
+	 * Reads both ports' inputs, one transfer with BANK=0, two with BANK=1
+	 * @return PICO_ERROR_NONE or a negative MCP23017_ERROR_*
+	 */
+	int update_input_values() {
+		if constexpr (Bank == Mcp23017_bank::paired) {
+			uint8_t values[2];
+			int result = read_registers(register_address(Mcp23017_register::gpio), values, 2);
+			if (result < PICO_ERROR_NONE) {
+				return result;
+			}
+			last_input = static_cast<uint16_t>((values[1] << 8) | values[0]);
+			return PICO_ERROR_NONE;
+		} else {
+			int result = update_port_input_values<Mcp23017_port::a>();
+			if (result < PICO_ERROR_NONE) {
+				return result;
+			}
+			result = update_port_input_values<Mcp23017_port::b>();
+			return result < PICO_ERROR_NONE ? result : PICO_ERROR_NONE;
+		}
+	}
+
+	template<uint8_t Pin>
+	[[nodiscard]] bool get_input() const {
+		static_assert(Pin < 16, "MCP23017 pins are 0-15");
+		return last_input & (1u << Pin);
+	}
+
+	[[nodiscard]] uint16_t get_input_values() const {
+		return last_input;
+	}
+
+	template<uint8_t Pin>
+	void set_output(bool set) {
+		static_assert(Pin < 16, "MCP23017 pins are 0-15");
+		constexpr uint16_t mask = 1u << Pin;
+		output = static_cast<uint16_t>((output & ~mask) | (-static_cast<uint16_t>(set) & mask));
+	}
+
+	template<uint8_t Pin>
+	[[nodiscard]] bool get_output() const {
+		static_assert(Pin < 16, "MCP23017 pins are 0-15");
+		return output & (1u << Pin);
+	}
+
+	void set_outputs(uint16_t all_bits) {
+		output = all_bits;
+	}
+
+	/**
+	 * Writes one port's output latch, a single register write in either layout
+	 * @return PICO_ERROR_NONE or a negative MCP23017_ERROR_*
+	 */
+	template<Mcp23017_port Port>
+	int flush_port_output() {
+		constexpr int shift = Port == Mcp23017_port::a ? 0 : 8;
+		return write_register(register_address(Mcp23017_register::olat, Port), static_cast<uint8_t>(output >> shift));
+	}
+
+	/**
+	 * Writes both ports' output latches, one transfer with BANK=0, two with BANK=1
+	 * @return PICO_ERROR_NONE or a negative MCP23017_ERROR_*
+	 */
+	int flush_output() {
+		return write_pair(Mcp23017_register::olat, output);
+	}
+
+private:
+	int write_register(uint8_t reg, uint8_t value) {
+		return transfer(reg, &value, nullptr, 1);
+	}
+
+	int write_pair(Mcp23017_register reg, uint16_t value) {
+		if constexpr (Bank == Mcp23017_bank::paired) {
+			uint8_t values[] = {static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8)};
+			return transfer(register_address(reg), values, nullptr, 2);
+		} else {
+			int result = write_register(register_address(reg, Mcp23017_port::a), static_cast<uint8_t>(value));
+			if (result < PICO_ERROR_NONE) {
+				return result;
+			}
+			return write_register(register_address(reg, Mcp23017_port::b), static_cast<uint8_t>(value >> 8));
+		}
+	}
+
+	int read_registers(uint8_t reg, uint8_t *buffer, size_t length) {
+		return transfer(reg, nullptr, buffer, length);
+	}
+
+	/**
+	 * Writes src or reads into dst, retried under the io policy
+	 */
+	int transfer(uint8_t reg, const uint8_t *src, uint8_t *dst, size_t length) {
+#ifdef STATS_MCP23017
+		uint32_t started_us = time_us_32();
+#endif
+		int result = transfer_once(reg, src, dst, length);
+		for (int retry = 0; retry < io_policy.retries && result != PICO_ERROR_NONE; retry++) {
+			mcp_debug("transfer to 0x%02x failed: %d, retry %d\n", reg, result, retry);
+			mcp_stats(stats.retries++);
+			if (mcp23017_prepare_retry(io_policy, retry, result) != PICO_ERROR_NONE) {
+				result = MCP23017_ERROR_BUS_STUCK;
+				break;
+			}
+			result = transfer_once(reg, src, dst, length);
+		}
+#ifdef STATS_MCP23017
+		record_operation(reg, dst != nullptr, result, started_us);
+#endif
+		return result;
+	}
+
+	int transfer_once(uint8_t reg, const uint8_t *src, uint8_t *dst, size_t length) {
+		int result;
+		if (dst == nullptr) {
+			uint8_t command[3] = {reg};
+			for (size_t i = 0; i < length; i++) {
+				command[1 + i] = src[i];
+			}
+			result = get_transport().write(Address, command, 1 + length, false, io_policy.timeout_us);
+			mcp_stats(stats.transactions++, stats.bytes += 1 + length);
+			return result < PICO_ERROR_NONE ? result : PICO_ERROR_NONE;
+		}
+
+		result = get_transport().write(Address, &reg, 1, true, io_policy.timeout_us);
+		mcp_stats(stats.transactions++, stats.bytes++);
+		if (result < PICO_ERROR_NONE) {
+			return result;
+		}
+		result = get_transport().read(Address, dst, length, false, io_policy.timeout_us);
+		mcp_stats(stats.transactions++, stats.bytes += length);
+		return result < PICO_ERROR_NONE ? result : PICO_ERROR_NONE;
+	}
+
+#ifdef STATS_MCP23017
+	void record_operation(uint8_t reg, bool read, int result, uint32_t started_us) {
+		//the register within its port in either layout, 0x0B is past OLAT in BANK=1
+		auto index = static_cast<uint8_t>(Bank == Mcp23017_bank::paired ? reg / 2 : reg & 0x0f);
+		Mcp23017_stats_operation operation;
+		if (read) {
+			if (index == static_cast<uint8_t>(Mcp23017_register::gpio)) {
+				operation = MCP23017_STATS_READ_INPUT;
+			} else if (index == static_cast<uint8_t>(Mcp23017_register::intf)
+					   || index == static_cast<uint8_t>(Mcp23017_register::intcap)) {
+				operation = MCP23017_STATS_READ_INTERRUPT;
+			} else {
+				operation = MCP23017_STATS_READ_OTHER;
+			}
+		} else {
+			operation = index == static_cast<uint8_t>(Mcp23017_register::olat)
+						? MCP23017_STATS_WRITE_OUTPUT : MCP23017_STATS_WRITE_CONFIG;
+		}
+		if (result != PICO_ERROR_NONE) {
+			stats.errors++;
+		}
+		stats.latency[operation][mcp23017_stats_bucket(time_us_32() - started_us)]++;
+	}
+#endif
+
+private:
+	mutable Mcp23017_pico_transport pico_transport;
+	Mcp23017_transport *transport{}; //nullptr for pico_transport
+	Mcp23017_io_policy io_policy;
+#ifdef STATS_MCP23017
+	Mcp23017_stats stats{};
+#endif
+	uint16_t output{};
+	uint16_t last_input{};
+};
+
+#endif //MCP23017_T_H
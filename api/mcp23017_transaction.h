@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MCP23017_TRANSACTION_H
+#define MCP23017_TRANSACTION_H
+
+#include "mcp23017.h"
+
+#define MCP23017_TRANSACTION_MAX_DATA MCP23017_REGISTER_COUNT
+
+/**
+ * Describes a register read or write, owned by the caller until the callback has been made
+ */
+struct Mcp23017_transaction {
+	Mcp23017 *device{};
+	uint8_t address{};
+	uint8_t reg{};
+	uint8_t length{}; //registers to read or write
+	bool read{};
+	uint8_t data[MCP23017_TRANSACTION_MAX_DATA]{}; //values to write or the values read
+	volatile int result{PICO_ERROR_NONE};
+	volatile bool busy{};
+	mcp23017_transaction_callback callback{};
+	void *context{};
+	Mcp23017_transaction *next{};
+};
+
+/**
+ * Queues transactions for one i2c bus and runs them in turn without blocking the caller
+ *
+ * Note: Don't mix blocking Mcp23017 calls with queued transactions on the same bus while the queue is busy
+ */
+class Mcp23017_transaction_queue {
+public:
+	/**
+	 * Create a queue for the specified i2c bus, the bus is expected to be already initialised
+	 * @param i2c selected bus
+	 */
+	explicit Mcp23017_transaction_queue(i2c_inst_t *i2c);
+
+	/**
+	 * Adds a transaction to the queue, starting it straight away if the bus is idle
+	 * @param transaction the transaction, must not already be queued
+	 * @return PICO_ERROR_NONE or PICO_ERROR_GENERIC
+	 */
+	int submit(Mcp23017_transaction &transaction);
+
+	/**
+	 * Checks if all queued transactions have finished
+	 * @return true if idle
+	 */
+	[[nodiscard]] bool is_idle() const;
+
+	/**
+	 * Gets the bus we were constructed to run transactions on
+	 * @return the bus
+	 */
+	[[nodiscard]] i2c_inst_t *get_i2c() const;
+
+	/**
+	 * Called by the port layer when the active transaction has finished
+	 * @param result PICO_ERROR_NONE or PICO_ERROR_GENERIC
+	 */
+	void transaction_finished(int result);
+
+private:
+	i2c_inst_t *i2c;
+	Mcp23017_transaction *volatile head{};
+	Mcp23017_transaction *tail{};
+};
+
+/**
+ * Port layer, starts the transaction on the hardware (or mock) and calls queue.transaction_finished when done
+ */
+void mcp23017_port_start(Mcp23017_transaction_queue &queue, Mcp23017_transaction &transaction);
+
+#endif //MCP23017_TRANSACTION_H
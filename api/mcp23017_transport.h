@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MCP23017_TRANSPORT_H
+#define MCP23017_TRANSPORT_H
+
+#ifdef MOCK_PICO_PI
+#include "../test/pico_pi_mocks.h"
+#else
+#include "hardware/i2c.h"
+#endif
+
+/**
+ * Moves bytes to and from the devices on one i2c bus, every blocking transfer of a Mcp23017 goes through one
+ *
+ * Results follow the pico sdk: the number of bytes transferred, or MCP23017_ERROR_TIMEOUT or MCP23017_ERROR_NACK.
+ * A register read is a write of the register with nostop followed by the read.
+ */
+class Mcp23017_transport {
+public:
+	virtual ~Mcp23017_transport() = default;
+
+	/**
+	 * Writes bytes to a device
+	 * @param address device address
+	 * @param src the bytes, the first is normally the register
+	 * @param length number of bytes
+	 * @param nostop true to keep the bus, the next transfer then starts with a repeated start
+	 * @param timeout_us deadline for the transfer
+	 * @return bytes written or a negative error
+	 */
+	virtual int write(uint8_t address, const uint8_t *src, size_t length, bool nostop, uint32_t timeout_us) = 0;
+
+	/**
+	 * Reads bytes from a device, starting at its address pointer
+	 * @return bytes read or a negative error
+	 */
+	virtual int read(uint8_t address, uint8_t *dst, size_t length, bool nostop, uint32_t timeout_us) = 0;
+
+	/**
+	 * Identifies the physical bus, transports giving the same value share it
+	 */
+	[[nodiscard]] virtual const void *get_bus() const {
+		return this;
+	}
+};
+
+/**
+ * The pico sdk i2c functions, the mocked ones when built with MOCK_PICO_PI
+ */
+class Mcp23017_pico_transport : public Mcp23017_transport {
+public:
+	/**
+	 * @param _i2c the bus, expected to be already initialised
+	 */
+	explicit Mcp23017_pico_transport(i2c_inst_t *_i2c) : i2c(_i2c) {
+	}
+
+	int write(uint8_t address, const uint8_t *src, size_t length, bool nostop, uint32_t timeout_us) override {
+		return i2c_write_timeout_us(i2c, address, src, length, nostop, timeout_us);
+	}
+
+	int read(uint8_t address, uint8_t *dst, size_t length, bool nostop, uint32_t timeout_us) override {
+		return i2c_read_timeout_us(i2c, address, dst, length, nostop, timeout_us);
+	}
+
+	[[nodiscard]] const void *get_bus() const override {
+		return i2c;
+	}
+
+	[[nodiscard]] i2c_inst_t *get_i2c() const {
+		return i2c;
+	}
+
+private:
+	i2c_inst_t *i2c;
+};
+
+#endif //MCP23017_TRANSPORT_H
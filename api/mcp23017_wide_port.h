@@ -0,0 +1,187 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MCP23017_WIDE_PORT_H
+#define MCP23017_WIDE_PORT_H
+
+#include "mcp23017.h"
+
+/**
+ * Several devices used as one wide port, device n holds bits 16n to 16n+15 of the word
+ *
+ * Writes change the devices' output state, commit then flushes only the devices whose bits changed and each of those
+ * only writes the ports that changed. Devices may be on different buses, commit goes through them bus by bus so each
+ * bus's writes are issued back to back.
+ *
+ * Mcp23017_wide_port<uint64_t> lamps(mcp0, mcp1, mcp2, mcp3);
+ * lamps.write(0x00ff00000000ff00, 0x0012000000003400);
+ * lamps.commit(); //writes one port of mcp0 and one of mcp2
+ *
+ * @tparam Word unsigned type of 32, 64 or 128 bits, unsigned __int128 for 128
+ */
+template<typename Word>
+class Mcp23017_wide_port {
+	static_assert(static_cast<Word>(-1) > 0, "the word type must be unsigned");
+	static_assert(sizeof(Word) >= 4 && sizeof(Word) <= 16 && sizeof(Word) % 2 == 0, "the word holds 2 to 8 devices");
+
+public:
+	static constexpr int device_count = sizeof(Word) / 2;
+
+	/**
+	 * @param mcp the devices from least significant, one per 16 bits of the word, must outlive the port
+	 */
+	template<typename... Devices>
+	explicit Mcp23017_wide_port(Devices &... mcp) : devices{&mcp...} {
+		static_assert(sizeof...(Devices) == device_count, "one device is needed for each 16 bits of the word");
+		for (int i = 0; i < device_count; i++) {
+			commit_order[i] = i;
+		}
+		//group the devices by bus, keeping their order within a bus
+		for (int i = 1; i < device_count; i++) {
+			for (int j = i; j > 0 && bus_rank(commit_order[j]) < bus_rank(commit_order[j - 1]); j--) {
+				int swap = commit_order[j];
+				commit_order[j] = commit_order[j - 1];
+				commit_order[j - 1] = swap;
+			}
+		}
+	}
+
+	/**
+	 * Sets bits of the word, this must be committed to take effect
+	 * @param mask '1' bits are the bits to change
+	 * @param values '1' bits on, '0' bits off, bits outside the mask are ignored
+	 */
+	void write(Word mask, Word values) {
+		for (int i = 0; i < device_count; i++) {
+			uint16_t device_mask = slice(mask, i);
+			if (device_mask == 0) {
+				continue;
+			}
+			uint16_t before = devices[i]->get_output_bits();
+			devices[i]->write_bits(device_mask, slice(values, i));
+			if (devices[i]->get_output_bits() != before) {
+				changed |= 1u << i;
+			}
+		}
+	}
+
+	/**
+	 * Sets the whole word, this must be committed to take effect
+	 */
+	void write(Word values) {
+		write(static_cast<Word>(-1), values);
+	}
+
+	void set_bits(Word mask) {
+		write(mask, mask);
+	}
+
+	void clear_bits(Word mask) {
+		write(mask, 0);
+	}
+
+	void toggle_bits(Word mask) {
+		for (int i = 0; i < device_count; i++) {
+			uint16_t device_mask = slice(mask, i);
+			if (device_mask != 0) {
+				devices[i]->toggle_bits(device_mask);
+				changed |= 1u << i;
+			}
+		}
+	}
+
+	/**
+	 * Gets the word from the devices' output state
+	 */
+	[[nodiscard]] Word get_output() const {
+		Word word = 0;
+		for (int i = device_count - 1; i >= 0; i--) {
+			word = (word << 16) | devices[i]->get_output_bits();
+		}
+		return word;
+	}
+
+	/**
+	 * Flushes the devices whose bits changed since the last commit, the first commit flushes them all
+	 * @return PICO_ERROR_NONE or the error of a device that failed, the others are still flushed
+	 */
+	int commit() {
+		int result = PICO_ERROR_NONE;
+		for (int order = 0; order < device_count; order++) {
+			int i = commit_order[order];
+			if ((changed & (1u << i)) == 0) {
+				continue;
+			}
+			int device_result = devices[i]->flush_output();
+			if (device_result != PICO_ERROR_NONE) {
+				result = device_result; //left changed so the next commit tries again
+				continue;
+			}
+			changed &= ~(1u << i);
+		}
+		return result;
+	}
+
+	/**
+	 * Reads the inputs of every device
+	 * @return PICO_ERROR_NONE or the error of a device that failed, the others are still read
+	 */
+	int update_inputs() {
+		int result = PICO_ERROR_NONE;
+		for (int order = 0; order < device_count; order++) {
+			int device_result = devices[commit_order[order]]->update_and_get_input_values();
+			if (device_result != PICO_ERROR_NONE) {
+				result = device_result;
+			}
+		}
+		return result;
+	}
+
+	/**
+	 * Gets bits of the word from the last values read from the devices
+	 * @param mask '1' bits are the bits wanted
+	 */
+	[[nodiscard]] Word read(Word mask = static_cast<Word>(-1)) const {
+		Word word = 0;
+		for (int i = device_count - 1; i >= 0; i--) {
+			word = (word << 16) | devices[i]->get_last_input_pin_values();
+		}
+		return word & mask;
+	}
+
+	/**
+	 * Gets the devices with changes not yet committed
+	 * @return bit n set for device n
+	 */
+	[[nodiscard]] uint32_t get_changed_devices() const {
+		return changed;
+	}
+
+	[[nodiscard]] Mcp23017 &get_device(int index) const {
+		return *devices[index];
+	}
+
+private:
+	static uint16_t slice(Word word, int device) {
+		return static_cast<uint16_t>(word >> (16 * device));
+	}
+
+	int bus_rank(int device) const {
+		//buses in order of first appearance
+		for (int i = 0; i < device_count; i++) {
+			if (devices[i]->get_transport().get_bus() == devices[device]->get_transport().get_bus()) {
+				return i;
+			}
+		}
+		return device;
+	}
+
+	Mcp23017 *devices[device_count];
+	int commit_order[device_count]{};
+	uint32_t changed{(1u << device_count) - 1}; //the first commit brings every device in line with the word
+};
+
+#endif //MCP23017_WIDE_PORT_H
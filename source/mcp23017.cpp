@@ -6,95 +6,347 @@
 
 #include "../api/mcp23017.h"
 #include "../api/mcp23017_private.h"
+#include "../api/mcp23017_transaction.h"
 #include <cstdio>
 
 #ifdef MOCK_PICO_PI
 #include "../test/pico_pi_mocks.h"
 #else
 #include "hardware/gpio.h"
+#include "hardware/sync.h"
 #endif
 
 
-Mcp23017::Mcp23017(i2c_inst_t *_i2c, uint8_t _address) : i2c(_i2c), address(_address) {
+Mcp23017::Mcp23017(i2c_inst_t *_i2c, uint8_t _address) : i2c(_i2c), pico_transport(_i2c), address(_address),
+		output_lock(spin_lock_instance(next_striped_spin_lock_num())) {
 
 }
 
-int Mcp23017::write_register(uint8_t reg, uint8_t value) const {
-	uint8_t command[] = { reg, value };
-	int result = i2c_write_blocking(i2c, address, command, 2, false);
-	if (result == PICO_ERROR_GENERIC) {
-		return result;
-	}
-	return PICO_ERROR_NONE;
+Mcp23017::Mcp23017(Mcp23017_transport &_transport, uint8_t _address) : i2c(nullptr), pico_transport(nullptr),
+		transport(&_transport), address(_address), output_lock(spin_lock_instance(next_striped_spin_lock_num())) {
+
 }
 
-int Mcp23017::read_register(uint8_t reg) const {
-	uint8_t buffer = 0;
+int Mcp23017::transfer_once(uint8_t reg, const uint8_t *src, uint8_t *dst, size_t length) const {
+	uint32_t timeout_us = io_policy.timeout_us;
 	int result;
-	result = i2c_write_blocking(i2c, address,  &reg, 1, true);
-	mcp_debug("i2c_write_blocking: %d\n",result);
-	if (result == PICO_ERROR_GENERIC) {
+	if (dst == nullptr) {
+		if (length > MCP23017_REGISTER_COUNT) {
+			return PICO_ERROR_GENERIC;
+		}
+		uint8_t command[MCP23017_REGISTER_COUNT + 1];
+		command[0] = reg;
+		for (size_t i = 0; i < length; i++) {
+			command[1 + i] = src[i];
+		}
+		result = get_transport().write(address, command, 1 + length, false, timeout_us);
+		mcp_debug("transport write: %d\n", result);
+		mcp_stats(stats.transactions++, stats.bytes += 1 + length);
+		return result < PICO_ERROR_NONE ? result : PICO_ERROR_NONE;
+	}
+
+	result = get_transport().write(address, &reg, 1, true, timeout_us);
+	mcp_debug("transport write: %d\n", result);
+	mcp_stats(stats.transactions++, stats.bytes++);
+	if (result < PICO_ERROR_NONE) {
 		return result;
 	}
+	result = get_transport().read(address, dst, length, false, timeout_us);
+	mcp_debug("transport read: %d\n", result);
+	mcp_stats(stats.transactions++, stats.bytes += length);
+	return result < PICO_ERROR_NONE ? result : PICO_ERROR_NONE;
+}
 
-	result = i2c_read_blocking(i2c, address, &buffer, 1, false);
-	mcp_debug("i2c_read_blocking: %d, read: %d\n",result, buffer);
-	if (result == PICO_ERROR_GENERIC)
+int Mcp23017::transfer(uint8_t reg, const uint8_t *src, uint8_t *dst, size_t length) const {
+#ifdef STATS_MCP23017
+	uint32_t started_us = time_us_32();
+	int result = retry_transfer(reg, src, dst, length, transfer_once(reg, src, dst, length));
+	record_operation(reg, dst != nullptr, result, started_us);
+	return result;
+#else
+	return retry_transfer(reg, src, dst, length, transfer_once(reg, src, dst, length));
+#endif
+}
+
+int Mcp23017::retry_transfer(uint8_t reg, const uint8_t *src, uint8_t *dst, size_t length, int result) const {
+	for (int retry = 0; retry < io_policy.retries && result != PICO_ERROR_NONE; retry++) {
+		mcp_debug("transfer to 0x%02x failed: %d, retry %d\n", reg, result, retry);
+		mcp_stats(stats.retries++);
+		if (mcp23017_prepare_retry(io_policy, retry, result) != PICO_ERROR_NONE) {
+			return MCP23017_ERROR_BUS_STUCK;
+		}
+		result = transfer_once(reg, src, dst, length);
+	}
+	return result;
+}
+
+int Mcp23017::write_register(uint8_t reg, uint8_t value) const {
+	return transfer(reg, &value, nullptr, 1);
+}
+
+int Mcp23017::read_register(uint8_t reg) const {
+	uint8_t buffer = 0;
+	int result = read_registers(reg, &buffer, 1);
+	mcp_debug("read: %d\n", buffer);
+	if (result < PICO_ERROR_NONE)
 		return result;
 
 	return buffer;
 }
 
 int Mcp23017::write_dual_registers(uint8_t reg, int value) const {
-	uint8_t command[] = {
-			reg,
+	uint8_t values[] = {
 			static_cast<uint8_t>(value & 0xff),
 			static_cast<uint8_t>((value>>8) & 0xff)
 	};
-	int result = i2c_write_blocking(i2c, address, command, 3, false);
-	if (result == PICO_ERROR_GENERIC) {
-		return result;
-	}
-	return PICO_ERROR_NONE;
+	return transfer(reg, values, nullptr, 2);
 }
 
 int Mcp23017::read_dual_registers(uint8_t reg) const {
 	uint8_t buffer[2]{};
-	int result;
-	result = i2c_write_blocking(i2c, address,  &reg, 1, true);
-	mcp_debug("i2c_write_blocking: %d\n",result);
-	if (result == PICO_ERROR_GENERIC) {
+	int result = read_registers(reg, buffer, 2);
+	mcp_debug("read: %d,%d\n", buffer[0], buffer[1]);
+	if (result < PICO_ERROR_NONE)
 		return result;
+
+	return (buffer[1]<<8) + buffer[0];
+}
+
+int Mcp23017::read_registers(uint8_t reg, uint8_t *buffer, size_t length) const {
+	return transfer(reg, nullptr, buffer, length);
+}
+
+void Mcp23017::set_io_policy(const Mcp23017_io_policy &policy) {
+	io_policy = policy;
+}
+
+const Mcp23017_io_policy &Mcp23017::get_io_policy() const {
+	return io_policy;
+}
+
+uint32_t Mcp23017::get_worst_case_latency_us() const {
+	return mcp23017_worst_case_latency_us(io_policy, 2);
+}
+
+#ifdef STATS_MCP23017
+void Mcp23017::record_operation(uint8_t reg, bool read, int result, uint32_t started_us) const {
+	Mcp23017_stats_operation operation;
+	if (read) {
+		if (reg == MCP23017_GPIOA || reg == MCP23017_GPIOB) {
+			operation = MCP23017_STATS_READ_INPUT;
+		} else if (reg >= MCP23017_INTFA && reg <= MCP23017_INTCAPB) {
+			operation = MCP23017_STATS_READ_INTERRUPT;
+		} else {
+			operation = MCP23017_STATS_READ_OTHER;
+		}
+	} else {
+		operation = reg == MCP23017_OLATA || reg == MCP23017_OLATB ? MCP23017_STATS_WRITE_OUTPUT : MCP23017_STATS_WRITE_CONFIG;
 	}
+	if (result != PICO_ERROR_NONE) {
+		stats.errors++;
+	}
+	stats.latency[operation][mcp23017_stats_bucket(time_us_32() - started_us)]++;
+}
+#endif
+
+bool Mcp23017::get_stats(Mcp23017_stats &snapshot) const {
+#ifdef STATS_MCP23017
+	uint32_t status = save_and_disable_interrupts();
+	snapshot = stats;
+	restore_interrupts(status);
+	return true;
+#else
+	snapshot = {};
+	return false;
+#endif
+}
 
-	result = i2c_read_blocking(i2c, address, buffer, 2, false);
-	mcp_debug("i2c_read_blocking: %d, read: %d,%d\n",result, buffer[0], buffer[1]);
-	if (result == PICO_ERROR_GENERIC)
+void Mcp23017::reset_stats() {
+#ifdef STATS_MCP23017
+	uint32_t status = save_and_disable_interrupts();
+	stats = {};
+	restore_interrupts(status);
+#endif
+}
+
+void Mcp23017::cache_register(uint8_t reg, uint8_t value) {
+	registers[reg] = value;
+	registers_dirty |= (1u << reg);
+	if (reg == MCP23017_IOCONA || reg == MCP23017_IOCONB) {
+		//with IOCON.BANK=0 both addresses access the same register
+		int alias = reg == MCP23017_IOCONA ? MCP23017_IOCONB : MCP23017_IOCONA;
+		registers[alias] = value;
+		registers_dirty |= (1u << alias);
+	}
+}
+
+void Mcp23017::mark_register_written(uint8_t reg, bool written) {
+	uint32_t mask = 1u << reg;
+	if (reg == MCP23017_IOCONA || reg == MCP23017_IOCONB) {
+		mask = (1u << MCP23017_IOCONA) | (1u << MCP23017_IOCONB);
+	}
+	if (written) {
+		registers_valid |= mask;
+		registers_dirty &= ~mask;
+	} else {
+		registers_valid &= ~mask;
+	}
+}
+
+int Mcp23017::write_cached_register(uint8_t reg, uint8_t value) {
+	if (is_register_valid(reg) && registers[reg] == value) {
+		mcp_debug("skipped write of %d to 0x%02x\n", value, reg);
+		mcp_stats(stats.skipped_writes++);
+		return PICO_ERROR_NONE;
+	}
+	cache_register(reg, value);
+	int result = write_register(reg, value);
+	mark_register_written(reg, result == PICO_ERROR_NONE);
+	return result;
+}
+
+int Mcp23017::write_cached_dual_registers(uint8_t reg, int value) {
+	auto low = static_cast<uint8_t>(value & 0xff);
+	auto high = static_cast<uint8_t>((value>>8) & 0xff);
+	if (is_register_valid(reg) && registers[reg] == low && is_register_valid(reg + 1) && registers[reg + 1] == high) {
+		mcp_debug("skipped write of %d to 0x%02x\n", value, reg);
+		mcp_stats(stats.skipped_writes++);
+		return PICO_ERROR_NONE;
+	}
+	cache_register(reg, low);
+	cache_register(reg + 1, high);
+	int result = write_dual_registers(reg, value);
+	mark_register_written(reg, result == PICO_ERROR_NONE);
+	mark_register_written(reg + 1, result == PICO_ERROR_NONE);
+	return result;
+}
+
+void Mcp23017::invalidate_registers() {
+	registers_dirty |= registers_valid;
+	registers_valid = 0;
+}
+
+int Mcp23017::write_cached_registers(uint8_t reg, const uint8_t *values, size_t length) {
+	for (size_t i = 0; i < length; i++) {
+		cache_register(reg + i, values[i]);
+	}
+	int result = transfer(reg, values, nullptr, length);
+	if (result != PICO_ERROR_NONE) {
+		for (size_t i = 0; i < length; i++) {
+			mark_register_written(reg + i, false);
+		}
 		return result;
+	}
+	for (size_t i = 0; i < length; i++) {
+		mark_register_written(reg + i, true);
+	}
+	return PICO_ERROR_NONE;
+}
 
-	return (buffer[1]<<8) + buffer[0];
+int Mcp23017::resync_registers() {
+	int reg = 0;
+	while (reg < MCP23017_REGISTER_COUNT) {
+		if (!is_register_dirty(reg)) {
+			reg++;
+			continue;
+		}
+		int end = reg;
+		while (end < MCP23017_REGISTER_COUNT && is_register_dirty(end)) {
+			end++;
+		}
+		uint8_t values[MCP23017_REGISTER_COUNT];
+		for (int i = reg; i < end; i++) {
+			values[i - reg] = registers[i];
+		}
+		int result = write_cached_registers(reg, values, end - reg);
+		if (result != PICO_ERROR_NONE) {
+			return result;
+		}
+		reg = end;
+	}
+	return PICO_ERROR_NONE;
 }
 
-int Mcp23017::setup(bool mirroring, bool polarity) const {
+bool Mcp23017::is_register_valid(uint8_t reg) const {
+	return reg < MCP23017_REGISTER_COUNT && (registers_valid & (1u << reg));
+}
+
+bool Mcp23017::is_register_dirty(uint8_t reg) const {
+	return reg < MCP23017_REGISTER_COUNT && (registers_dirty & (1u << reg));
+}
+
+int Mcp23017::setup(bool mirroring, bool polarity) {
 	int result;
 	result = setup_bank_configuration(MCP23017_IOCONA, mirroring, polarity);
-	if (result != 0)
-		return PICO_ERROR_GENERIC;
+	if (result != PICO_ERROR_NONE)
+		return result;
 
 	result = setup_bank_configuration(MCP23017_IOCONB, mirroring, polarity);
 	return result;
 }
 
-int Mcp23017::setup_bank_configuration(int reg, bool mirroring, bool polarity) const {
-	int ioConValue = 0;
+int Mcp23017::setup_bank_configuration(int reg, bool mirroring, bool polarity) {
+	//keep the settings setup doesn't control, falling back to the power on defaults
+	int ioConValue = is_register_valid(reg) || is_register_dirty(reg) ? registers[reg] : 0;
 	set_bit(ioConValue, MCP23017_IOCON_BANK_BIT, false);
 	set_bit(ioConValue, MCP23017_IOCON_MIRROR_BIT, mirroring);
-	set_bit(ioConValue, MCP23017_IOCON_SEQOP_BIT, false);
-	set_bit(ioConValue, MCP23017_IOCON_DISSLW_BIT, false);
 	set_bit(ioConValue, MCP23017_IOCON_HAEN_BIT, false);
-	set_bit(ioConValue, MCP23017_IOCON_ODR_BIT, false);
 	set_bit(ioConValue, MCP23017_IOCON_INTPOL_BIT, polarity);
-	return write_register(reg, ioConValue);
+	return write_cached_register(reg, ioConValue);
+}
+
+int Mcp23017::apply(const Mcp23017_config &config) {
+	int ioConValue = 0;
+	set_bit(ioConValue, MCP23017_IOCON_BANK_BIT, false);
+	set_bit(ioConValue, MCP23017_IOCON_MIRROR_BIT, config.mirroring);
+	set_bit(ioConValue, MCP23017_IOCON_SEQOP_BIT, false); //sequential for the rest of this burst
+	set_bit(ioConValue, MCP23017_IOCON_DISSLW_BIT, !config.slew_rate);
+	set_bit(ioConValue, MCP23017_IOCON_HAEN_BIT, false);
+	set_bit(ioConValue, MCP23017_IOCON_ODR_BIT, config.open_drain);
+	set_bit(ioConValue, MCP23017_IOCON_INTPOL_BIT, config.polarity);
+
+	int pairs[] = {
+			config.io_direction, config.input_polarity, config.interrupt_enable, config.default_value,
+			config.interrupt_control, ioConValue | (ioConValue << 8), config.pullup
+	};
+	uint8_t values[MCP23017_CONFIG_REGISTER_COUNT];
+	for (int i = 0; i < MCP23017_CONFIG_REGISTER_COUNT / 2; i++) {
+		values[i * 2] = static_cast<uint8_t>(pairs[i] & 0xff);
+		values[i * 2 + 1] = static_cast<uint8_t>((pairs[i]>>8) & 0xff);
+	}
+
+	int finalIoConValue = ioConValue;
+	set_bit(finalIoConValue, MCP23017_IOCON_SEQOP_BIT, !config.sequential);
+
+	int first = MCP23017_CONFIG_REGISTER_COUNT;
+	int last = -1;
+	for (int reg = 0; reg < MCP23017_CONFIG_REGISTER_COUNT; reg++) {
+		int value = (reg == MCP23017_IOCONA || reg == MCP23017_IOCONB) ? finalIoConValue : values[reg];
+		if (!is_register_valid(reg) || registers[reg] != value) {
+			first = reg < first ? reg : first;
+			last = reg;
+		}
+	}
+	if (last < first) {
+		mcp_debug("skipped apply of unchanged config\n");
+		mcp_stats(stats.skipped_writes++);
+		return PICO_ERROR_NONE;
+	}
+	if (first >= MCP23017_IOCONA && last <= MCP23017_IOCONB) {
+		return write_cached_register(MCP23017_IOCONA, finalIoConValue);
+	}
+
+	int result;
+	if (is_register_valid(MCP23017_IOCONA) && is_bit_set(registers[MCP23017_IOCONA], MCP23017_IOCON_SEQOP_BIT)) {
+		result = write_cached_register(MCP23017_IOCONA, registers[MCP23017_IOCONA] & ~(1 << MCP23017_IOCON_SEQOP_BIT));
+		if (result != PICO_ERROR_NONE)
+			return result;
+	}
+	result = write_cached_registers(first, &values[first], last - first + 1);
+	if (result != PICO_ERROR_NONE)
+		return result;
+
+	return write_cached_register(MCP23017_IOCONA, finalIoConValue);
 }
 
 int Mcp23017::get_last_interrupt_pin() const {
@@ -102,12 +354,11 @@ int Mcp23017::get_last_interrupt_pin() const {
 
 	intFlag = read_dual_registers(MCP23017_INTFA); //also MCP23017_INTFB
 	mcp_debug("INTF %d",intFlag);
-	if (intFlag != PICO_ERROR_GENERIC) {
-		for (int i = 0; i < 16; i++) {
-			if (is_bit_set(intFlag, i)) {
-				return i;
-			}
-		}
+	if (intFlag < PICO_ERROR_NONE) {
+		return intFlag;
+	}
+	if (intFlag != 0) {
+		return __builtin_ctz(intFlag);
 	}
 
 	return PICO_ERROR_GENERIC;
@@ -117,10 +368,23 @@ int Mcp23017::get_interrupt_values() const {
 	return read_dual_registers(MCP23017_INTCAPA); //will include MCP23017_INTCAPB
 }
 
+int Mcp23017::service_interrupt(Mcp23017_interrupt_state &state) {
+	uint8_t buffer[6]{};
+	int result = read_registers(MCP23017_INTFA, buffer, 6); //INTFA,INTFB,INTCAPA,INTCAPB,GPIOA,GPIOB
+	if (result != PICO_ERROR_NONE)
+		return result;
+
+	state.flags = (buffer[1]<<8) + buffer[0];
+	state.captured = (buffer[3]<<8) + buffer[2];
+	state.inputs = (buffer[5]<<8) + buffer[4];
+	store_input_values(state.inputs);
+	return PICO_ERROR_NONE;
+}
+
 int Mcp23017::update_and_get_input_values() {
 	int result = read_dual_registers(MCP23017_GPIOA); //will include MCP23017_GPIOB
-	if (result != PICO_ERROR_GENERIC) {
-		last_input = result;
+	if (result >= PICO_ERROR_NONE) {
+		store_input_values(result);
 		result = PICO_ERROR_NONE;
 	}
 	return result;
@@ -134,39 +398,375 @@ uint16_t Mcp23017::get_last_input_pin_values() const {
 	return last_input;
 }
 
+void Mcp23017::store_input_values(uint16_t values) {
+	last_input = values;
+	debouncer.update(values);
+}
+
+void Mcp23017::set_debounce_depth(uint8_t depth) {
+	debouncer.set_depth(depth);
+}
+
+uint16_t Mcp23017::get_debounced_input_pin_values() const {
+	return debouncer.get_stable();
+}
+
+bool Mcp23017::get_debounced_input_pin_value(int pin) const {
+	return is_bit_set(debouncer.get_stable(), pin);
+}
+
+uint16_t Mcp23017::get_debounced_changed_mask() const {
+	return debouncer.get_changed();
+}
+
 int Mcp23017::get_address() const {
 	return address;
 }
 
-int Mcp23017::set_io_direction(int direction) const {
-	return write_dual_registers(MCP23017_IODIRA, direction); //inc MCP23017_IODIRB
+i2c_inst_t *Mcp23017::get_i2c() const {
+	return i2c;
 }
 
-int Mcp23017::set_pullup(int direction) const {
-	return write_dual_registers(MCP23017_GPPUA, direction); //inc MCP23017_GPPUB, direction >> 8);
+Mcp23017_transport &Mcp23017::get_transport() const {
+	return transport ? *transport : pico_transport;
 }
 
-int Mcp23017::set_interrupt_type(int compare_to_reg) const {
-	return write_dual_registers(MCP23017_INTCONA, compare_to_reg); //inc MCP23017_INTCONB
+int Mcp23017::set_io_direction(int direction) {
+	return write_cached_dual_registers(MCP23017_IODIRA, direction); //inc MCP23017_IODIRB
 }
 
-int Mcp23017::enable_interrupt(int enabled) const {
-	return write_dual_registers(MCP23017_GPINTENA, enabled); //inc MCP23017_GPINTENB
+int Mcp23017::set_pullup(int direction) {
+	return write_cached_dual_registers(MCP23017_GPPUA, direction); //inc MCP23017_GPPUB, direction >> 8);
+}
+
+int Mcp23017::set_interrupt_type(int compare_to_reg) {
+	return write_cached_dual_registers(MCP23017_INTCONA, compare_to_reg); //inc MCP23017_INTCONB
+}
+
+int Mcp23017::enable_interrupt(int enabled) {
+	return write_cached_dual_registers(MCP23017_GPINTENA, enabled); //inc MCP23017_GPINTENB
 }
 
 int Mcp23017::set_all_output_bits(int all_bits) {
-	output = all_bits;
-	return write_dual_registers(MCP23017_GPIOA, all_bits); //inc MCP23017_GPIOB
+	modify_output(0x0000, static_cast<uint16_t>(all_bits));
+	return flush_output();
 }
 
 void Mcp23017::set_output_bit_for_pin(int pin, bool set) {
-	set_bit(output, pin, set);
+	if (set) {
+		set_bits(mcp23017_pin_mask(pin));
+	} else {
+		clear_bits(mcp23017_pin_mask(pin));
+	}
 }
 
 bool Mcp23017::get_output_bit_for_pin(int pin) const {
-	return is_bit_set(output, pin);
+	return is_bit_set(get_output_bits(), pin);
+}
+
+void Mcp23017::set_bits(uint16_t mask) {
+	modify_output(static_cast<uint16_t>(~mask), mask);
+}
+
+void Mcp23017::clear_bits(uint16_t mask) {
+	modify_output(static_cast<uint16_t>(~mask), 0x0000);
+}
+
+void Mcp23017::toggle_bits(uint16_t mask) {
+	modify_output(0xffff, mask);
+}
+
+void Mcp23017::write_bits(uint16_t mask, uint16_t values) {
+	modify_output(static_cast<uint16_t>(~mask), values & mask);
+}
+
+uint16_t Mcp23017::get_output_bits() const {
+	uint32_t status = spin_lock_blocking(output_lock);
+	auto bits = static_cast<uint16_t>(output);
+	spin_unlock(output_lock, status);
+	return bits;
+}
+
+void Mcp23017::modify_output(uint16_t keep, uint16_t invert) {
+	uint32_t status = spin_lock_blocking(output_lock);
+	output = (output & keep) ^ invert;
+	spin_unlock(output_lock, status);
+}
+
+int Mcp23017::flush_output() {
+	if (deferred_flush_depth > 0) {
+		return PICO_ERROR_NONE;
+	}
+	return flush_output_immediate();
+}
+
+void Mcp23017::begin_deferred_flush() {
+	deferred_flush_depth++;
+}
+
+int Mcp23017::end_deferred_flush() {
+	if (deferred_flush_depth > 0 && --deferred_flush_depth > 0) {
+		return PICO_ERROR_NONE;
+	}
+	return flush_output_immediate();
+}
+
+int Mcp23017::flush_output_immediate() {
+	uint32_t status = spin_lock_blocking(output_lock);
+	flush_pending = true;
+	if (flushing) {
+		//the other core writes again once its current write is done, picking up this change
+		spin_unlock(output_lock, status);
+		return PICO_ERROR_NONE;
+	}
+	flushing = true;
+	int result = PICO_ERROR_NONE;
+	while (flush_pending) {
+		flush_pending = false;
+		int value = output;
+		spin_unlock(output_lock, status);
+		result = write_output(value);
+		status = spin_lock_blocking(output_lock);
+	}
+	flushing = false;
+	spin_unlock(output_lock, status);
+	return result;
+}
+
+bool Mcp23017::is_output_flushed(uint16_t mask) const {
+	if ((mask & 0x00ff) && !is_register_valid(MCP23017_OLATA)) {
+		return false;
+	}
+	if ((mask & 0xff00) && !is_register_valid(MCP23017_OLATB)) {
+		return false;
+	}
+	auto written = static_cast<uint16_t>(registers[MCP23017_OLATA] | (registers[MCP23017_OLATB] << 8));
+	return ((get_output_bits() ^ written) & mask) == 0;
+}
+
+int Mcp23017::write_output(int value) {
+	auto port_a = static_cast<uint8_t>(value & 0xff);
+	auto port_b = static_cast<uint8_t>((value>>8) & 0xff);
+	bool port_a_changed = !is_register_valid(MCP23017_OLATA) || registers[MCP23017_OLATA] != port_a;
+	bool port_b_changed = !is_register_valid(MCP23017_OLATB) || registers[MCP23017_OLATB] != port_b;
+
+	if (port_a_changed && port_b_changed) {
+		return write_cached_dual_registers(MCP23017_OLATA, value); //inc MCP23017_OLATB
+	}
+	if (port_a_changed) {
+		return write_cached_register(MCP23017_OLATA, port_a);
+	}
+	if (port_b_changed) {
+		return write_cached_register(MCP23017_OLATB, port_b);
+	}
+	mcp_debug("skipped flush of unchanged output %d\n", value);
+	mcp_stats(stats.skipped_writes++);
+	return PICO_ERROR_NONE;
+}
+
+int Mcp23017::begin_byte_mode(bool &restore) {
+	int ioConValue = is_register_valid(MCP23017_IOCONA) || is_register_dirty(MCP23017_IOCONA) ? registers[MCP23017_IOCONA] : 0;
+	restore = !is_bit_set(ioConValue, MCP23017_IOCON_SEQOP_BIT);
+	if (!restore) {
+		return PICO_ERROR_NONE;
+	}
+	int result = write_cached_register(MCP23017_IOCONA, ioConValue | (1 << MCP23017_IOCON_SEQOP_BIT));
+	if (result < PICO_ERROR_NONE) {
+		restore = false;
+	}
+	return result;
+}
+
+int Mcp23017::end_byte_mode(bool restore, int result) {
+	if (!restore) {
+		return result;
+	}
+	int restored = write_cached_register(MCP23017_IOCONA, registers[MCP23017_IOCONA] & ~(1 << MCP23017_IOCON_SEQOP_BIT));
+	return result == PICO_ERROR_NONE ? restored : result;
+}
+
+int Mcp23017::stream_output(const uint16_t *words, size_t count) {
+	if (count == 0) {
+		return PICO_ERROR_NONE;
+	}
+	bool restore;
+	int result = begin_byte_mode(restore);
+	if (result < PICO_ERROR_NONE) {
+		return result;
+	}
+
+#ifdef STATS_MCP23017
+	uint32_t started_us = time_us_32();
+#endif
+	for (size_t sent = 0; sent < count && result == PICO_ERROR_NONE;) {
+		size_t length = count - sent < MCP23017_STREAM_CHUNK_WORDS ? count - sent : MCP23017_STREAM_CHUNK_WORDS;
+		result = write_stream_chunk(&words[sent], length, sent + length == count);
+		sent += length;
+	}
+	mcp_stats(record_operation(MCP23017_OLATA, false, result, started_us));
+
+	//after a failure the word the device holds is unknown, the last word is left dirty for the next flush or resync
+	uint16_t last = words[count - 1];
+	cache_register(MCP23017_OLATA, last & 0xff);
+	cache_register(MCP23017_OLATB, last >> 8);
+	mark_register_written(MCP23017_OLATA, result == PICO_ERROR_NONE);
+	mark_register_written(MCP23017_OLATB, result == PICO_ERROR_NONE);
+	modify_output(0x0000, last);
+
+	return end_byte_mode(restore, result);
 }
 
-int Mcp23017::flush_output() const {
-	return write_dual_registers(MCP23017_GPIOA, output); //inc MCP23017_GPIOB
+int Mcp23017::write_stream_chunk(const uint16_t *words, size_t count, bool last) {
+	uint8_t command[1 + 2 * MCP23017_STREAM_CHUNK_WORDS];
+	command[0] = MCP23017_OLATA; //each chunk starts again at port A, the pointer is reloaded after the restart
+	for (size_t i = 0; i < count; i++) {
+		command[1 + 2 * i] = static_cast<uint8_t>(words[i] & 0xff);
+		command[2 + 2 * i] = static_cast<uint8_t>((words[i]>>8) & 0xff);
+	}
+	int result = get_transport().write(address, command, 1 + 2 * count, !last, io_policy.timeout_us);
+	mcp_debug("transport write: %d\n", result);
+	mcp_stats(stats.transactions++, stats.bytes += 1 + 2 * count);
+	return result < PICO_ERROR_NONE ? result : PICO_ERROR_NONE;
+}
+
+int Mcp23017::stream_input(size_t count, mcp23017_input_stream_handler handler, void *context) {
+	if (count == 0) {
+		return PICO_ERROR_NONE;
+	}
+	bool restore;
+	int result = begin_byte_mode(restore);
+	if (result < PICO_ERROR_NONE) {
+		return result;
+	}
+
+#ifdef STATS_MCP23017
+	uint32_t operation_started_us = time_us_32();
+#endif
+	uint64_t started_us = time_us_64();
+	uint8_t reg = MCP23017_GPIOA;
+	result = get_transport().write(address, &reg, 1, true, io_policy.timeout_us);
+	mcp_debug("transport write: %d\n", result);
+	mcp_stats(stats.transactions++, stats.bytes++);
+	result = result < PICO_ERROR_NONE ? result : PICO_ERROR_NONE;
+
+	uint8_t buffer[2 * MCP23017_STREAM_CHUNK_WORDS];
+	uint16_t samples[MCP23017_STREAM_CHUNK_WORDS];
+	for (size_t received = 0; received < count && result == PICO_ERROR_NONE;) {
+		size_t length = count - received < MCP23017_STREAM_CHUNK_WORDS ? count - received : MCP23017_STREAM_CHUNK_WORDS;
+		//the pointer carries on toggling between GPIOA and GPIOB across the restart, no need to send it again
+		result = get_transport().read(address, buffer, 2 * length, received + length < count, io_policy.timeout_us);
+		mcp_debug("transport read: %d\n", result);
+		mcp_stats(stats.transactions++, stats.bytes += 2 * length);
+		if (result < PICO_ERROR_NONE) {
+			break;
+		}
+		result = PICO_ERROR_NONE;
+		uint64_t finished_us = time_us_64();
+		for (size_t i = 0; i < length; i++) {
+			samples[i] = (buffer[2 * i + 1]<<8) + buffer[2 * i];
+		}
+		store_input_values(samples[length - 1]);
+		handler(samples, length, started_us, finished_us, context);
+		received += length;
+		started_us = finished_us;
+	}
+	mcp_stats(record_operation(MCP23017_GPIOA, true, result, operation_started_us));
+
+	return end_byte_mode(restore, result);
+}
+
+int Mcp23017::scan_matrix(const uint8_t *row_drives, uint8_t *columns, size_t rows) {
+	if (rows == 0) {
+		return PICO_ERROR_NONE;
+	}
+#ifdef STATS_MCP23017
+	uint32_t started_us = time_us_32();
+#endif
+	int result = PICO_ERROR_NONE;
+	for (size_t row = 0; row < rows && result == PICO_ERROR_NONE; row++) {
+		uint8_t command[] = {MCP23017_GPIOA, row_drives[row]};
+		result = get_transport().write(address, command, 2, true, io_policy.timeout_us);
+		mcp_debug("transport write: %d\n", result);
+		mcp_stats(stats.transactions++, stats.bytes += 2);
+		if (result < PICO_ERROR_NONE) {
+			break;
+		}
+		result = get_transport().read(address, &columns[row], 1, row + 1 < rows, io_policy.timeout_us); //GPIOB
+		mcp_debug("transport read: %d\n", result);
+		mcp_stats(stats.transactions++, stats.bytes++);
+		result = result < PICO_ERROR_NONE ? result : PICO_ERROR_NONE;
+	}
+	mcp_stats(record_operation(MCP23017_GPIOA, true, result, started_us));
+
+	uint8_t last = row_drives[rows - 1];
+	cache_register(MCP23017_OLATA, last);
+	mark_register_written(MCP23017_OLATA, result == PICO_ERROR_NONE);
+	modify_output(0xff00, last);
+	return result;
+}
+
+void Mcp23017::set_transaction_queue(Mcp23017_transaction_queue *queue) {
+	transaction_queue = queue;
+}
+
+int Mcp23017::read_registers_async(Mcp23017_transaction &transaction, uint8_t reg, uint8_t length,
+								   mcp23017_transaction_callback callback, void *context) {
+	if (transaction_queue == nullptr || transaction.busy || length > MCP23017_TRANSACTION_MAX_DATA) {
+		return PICO_ERROR_GENERIC;
+	}
+	transaction.device = this;
+	transaction.address = address;
+	transaction.reg = reg;
+	transaction.length = length;
+	transaction.read = true;
+	transaction.callback = callback;
+	transaction.context = context;
+	return transaction_queue->submit(transaction);
+}
+
+int Mcp23017::write_registers_async(Mcp23017_transaction &transaction, uint8_t reg, const uint8_t *values, uint8_t length,
+									mcp23017_transaction_callback callback, void *context) {
+	if (transaction_queue == nullptr || transaction.busy || length > MCP23017_TRANSACTION_MAX_DATA
+		|| reg + length > MCP23017_REGISTER_COUNT) {
+		return PICO_ERROR_GENERIC;
+	}
+	transaction.device = this;
+	transaction.address = address;
+	transaction.reg = reg;
+	transaction.length = length;
+	transaction.read = false;
+	transaction.callback = callback;
+	transaction.context = context;
+	for (int i = 0; i < length; i++) {
+		transaction.data[i] = values[i];
+		cache_register(reg + i, values[i]);
+	}
+	return transaction_queue->submit(transaction);
+}
+
+int Mcp23017::update_input_values_async(Mcp23017_transaction &transaction, mcp23017_transaction_callback callback, void *context) {
+	return read_registers_async(transaction, MCP23017_GPIOA, 2, callback, context); //will include MCP23017_GPIOB
+}
+
+int Mcp23017::flush_output_async(Mcp23017_transaction &transaction, mcp23017_transaction_callback callback, void *context) {
+	uint16_t bits = get_output_bits();
+	uint8_t values[] = {
+			static_cast<uint8_t>(bits & 0xff),
+			static_cast<uint8_t>((bits>>8) & 0xff)
+	};
+	return write_registers_async(transaction, MCP23017_OLATA, values, 2, callback, context); //inc MCP23017_OLATB
+}
+
+void Mcp23017::transaction_complete(Mcp23017_transaction &transaction) {
+	bool ok = transaction.result == PICO_ERROR_NONE;
+	mcp_stats(stats.transactions += transaction.read ? 2 : 1, stats.bytes += 1 + transaction.length, stats.errors += ok ? 0 : 1);
+	if (transaction.read) {
+		if (ok && transaction.reg == MCP23017_GPIOA && transaction.length >= 2) {
+			store_input_values((transaction.data[1]<<8) + transaction.data[0]);
+		}
+		return;
+	}
+	for (int i = 0; i < transaction.length; i++) {
+		mark_register_written(transaction.reg + i, ok);
+	}
 }
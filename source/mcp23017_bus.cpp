@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "../api/mcp23017_bus.h"
+#include "../api/mcp23017_private.h"
+
+#ifdef MOCK_PICO_PI
+#include "../test/pico_pi_mocks.h"
+#endif
+
+
+Mcp23017_bus::Mcp23017_bus(i2c_inst_t *_i2c) : bus(_i2c) {
+
+}
+
+Mcp23017_bus::Mcp23017_bus(const Mcp23017_transport &transport) : bus(transport.get_bus()) {
+
+}
+
+int Mcp23017_bus::add_device(Mcp23017 &mcp) {
+	if (device_count >= MCP23017_BUS_MAX_DEVICES || mcp.get_transport().get_bus() != bus) {
+		return PICO_ERROR_GENERIC;
+	}
+	for (int i = 0; i < device_count; i++) {
+		if (devices[i]->get_address() == mcp.get_address()) {
+			return PICO_ERROR_GENERIC;
+		}
+	}
+	devices[device_count] = &mcp;
+	return device_count++;
+}
+
+int Mcp23017_bus::poll_all() {
+	int result = PICO_ERROR_NONE;
+	for (int i = 0; i < device_count; i++) {
+		bool last = i == device_count - 1;
+		uint8_t reg = MCP23017_GPIOA; //will include MCP23017_GPIOB
+		uint8_t buffer[2]{};
+		auto address = static_cast<uint8_t>(devices[i]->get_address());
+		uint32_t timeout_us = devices[i]->get_io_policy().timeout_us;
+#ifdef STATS_MCP23017
+		uint32_t started_us = time_us_32();
+#endif
+		Mcp23017_transport &transport = devices[i]->get_transport();
+		int transfer_result = transport.write(address, &reg, 1, true, timeout_us);
+		mcp_stats(devices[i]->stats.transactions++, devices[i]->stats.bytes++);
+		if (transfer_result >= PICO_ERROR_NONE) {
+			transfer_result = transport.read(address, buffer, 2, !last, timeout_us);
+			mcp_stats(devices[i]->stats.transactions++, devices[i]->stats.bytes += 2);
+		}
+		if (transfer_result < PICO_ERROR_NONE) {
+			//the chained read was the first attempt, the rest are made on their own under the device io policy
+			mcp_debug("poll of 0x%02x failed\n", address);
+			transfer_result = devices[i]->retry_transfer(reg, nullptr, buffer, 2, transfer_result);
+		} else {
+			transfer_result = PICO_ERROR_NONE;
+		}
+		mcp_stats(devices[i]->record_operation(reg, true, transfer_result, started_us));
+		if (transfer_result != PICO_ERROR_NONE) {
+			result = transfer_result;
+			continue;
+		}
+		snapshot[i] = (buffer[1]<<8) + buffer[0];
+		devices[i]->store_input_values(snapshot[i]);
+	}
+	return result;
+}
+
+int Mcp23017_bus::flush_all() {
+	int result = PICO_ERROR_NONE;
+	for (int i = 0; i < device_count; i++) {
+		int flush_result = devices[i]->flush_output();
+		if (flush_result != PICO_ERROR_NONE) {
+			result = flush_result;
+		}
+	}
+	return result;
+}
+
+const uint16_t *Mcp23017_bus::get_snapshot() const {
+	return snapshot;
+}
+
+int Mcp23017_bus::get_device_count() const {
+	return device_count;
+}
+
+Mcp23017 *Mcp23017_bus::get_device(int index) const {
+	if (index < 0 || index >= device_count) {
+		return nullptr;
+	}
+	return devices[index];
+}
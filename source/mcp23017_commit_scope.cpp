@@ -0,0 +1,51 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "../api/mcp23017_commit_scope.h"
+
+
+Mcp23017_commit_scope::Mcp23017_commit_scope(Mcp23017 &mcp) {
+	add(&mcp);
+}
+
+Mcp23017_commit_scope::Mcp23017_commit_scope(std::initializer_list<Mcp23017 *> _devices) {
+	for (auto mcp : _devices) {
+		add(mcp);
+	}
+}
+
+Mcp23017_commit_scope::Mcp23017_commit_scope(const Mcp23017_bus &bus) {
+	for (int i = 0; i < bus.get_device_count(); i++) {
+		add(bus.get_device(i));
+	}
+}
+
+Mcp23017_commit_scope::~Mcp23017_commit_scope() {
+	commit();
+}
+
+void Mcp23017_commit_scope::add(Mcp23017 *mcp) {
+	if (mcp == nullptr || device_count >= MCP23017_COMMIT_SCOPE_MAX_DEVICES) {
+		return;
+	}
+	mcp->begin_deferred_flush();
+	devices[device_count++] = mcp;
+}
+
+int Mcp23017_commit_scope::commit() {
+	if (committed) {
+		return PICO_ERROR_NONE;
+	}
+	committed = true;
+	int result = PICO_ERROR_NONE;
+	for (int i = 0; i < device_count; i++) {
+		int flush_result = devices[i]->end_deferred_flush();
+		if (flush_result != PICO_ERROR_NONE) {
+			result = flush_result;
+		}
+	}
+	return result;
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "../api/mcp23017_dispatcher.h"
+
+
+Mcp23017_dispatcher::Mcp23017_dispatcher(Mcp23017 &mcp) : _mcp(mcp) {
+
+}
+
+int Mcp23017_dispatcher::on_pin(int pin, mcp23017_pin_handler handler, void *context) {
+	if (pin < 0 || pin > 15) {
+		return PICO_ERROR_GENERIC;
+	}
+	pin_handlers[pin] = {handler, context};
+	if (handler) {
+		pins_with_handlers |= (1u << pin);
+	} else {
+		pins_with_handlers &= ~(1u << pin);
+	}
+	return PICO_ERROR_NONE;
+}
+
+int Mcp23017_dispatcher::on_mask(uint16_t mask, mcp23017_mask_handler handler, void *context) {
+	if (mask_handler_count >= MCP23017_DISPATCHER_MAX_MASK_HANDLERS || handler == nullptr) {
+		return PICO_ERROR_GENERIC;
+	}
+	mask_handlers[mask_handler_count++] = {mask, handler, context};
+	return PICO_ERROR_NONE;
+}
+
+int Mcp23017_dispatcher::poll() {
+	uint16_t previous = _mcp.get_last_input_pin_values();
+	int result = _mcp.update_and_get_input_values();
+	if (result != PICO_ERROR_NONE) {
+		return result;
+	}
+	uint16_t values = _mcp.get_last_input_pin_values();
+	dispatch(values ^ previous, values);
+	return PICO_ERROR_NONE;
+}
+
+int Mcp23017_dispatcher::service_interrupt() {
+	uint16_t previous = _mcp.get_last_input_pin_values();
+	Mcp23017_interrupt_state state{};
+	int result = _mcp.service_interrupt(state);
+	if (result != PICO_ERROR_NONE) {
+		return result;
+	}
+	//a pin that flipped and flipped back is only visible in INTF
+	dispatch(state.flags | (state.inputs ^ previous), state.inputs);
+	return PICO_ERROR_NONE;
+}
+
+void Mcp23017_dispatcher::dispatch(uint16_t changed, uint16_t values) {
+	uint32_t pending = changed & pins_with_handlers;
+	while (pending) {
+		int pin = __builtin_ctz(pending);
+		pending &= pending - 1;
+		pin_handlers[pin].handler(_mcp, pin, (values >> pin) & 1, pin_handlers[pin].context);
+	}
+	for (int i = 0; i < mask_handler_count; i++) {
+		uint16_t masked = changed & mask_handlers[i].mask;
+		if (masked) {
+			mask_handlers[i].handler(_mcp, masked, values, mask_handlers[i].context);
+		}
+	}
+}
@@ -5,11 +5,12 @@
  */
 
 #include <mcp23017_input.h>
+#include <mcp23017_private.h>
 
 Mcp23017_input::Mcp23017_input(Mcp23017 &mcp, int detect)
-: _mcp_detect(mcp), _detect_pin(detect) {
+: _mcp_detect(mcp), _detect_mask(mcp23017_pin_mask(detect)) {
 }
 
 bool Mcp23017_input::get_current_state() const {
-	return _mcp_detect.get_last_input_pin_value(_detect_pin);
+	return _mcp_detect.get_debounced_input_pin_values() & _detect_mask;
 }
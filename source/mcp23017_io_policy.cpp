@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "../api/mcp23017_io_policy.h"
+
+#ifdef MOCK_PICO_PI
+#include "../test/pico_pi_mocks.h"
+#else
+#include "hardware/gpio.h"
+#include "hardware/timer.h"
+#include "pico/time.h"
+#endif
+
+
+int mcp23017_recover_bus(uint sda_gpio, uint scl_gpio) {
+	//open drain, the outputs stay low and the direction drives the line: out pulls it low, in releases it to the pull up
+	gpio_init(sda_gpio);
+	gpio_pull_up(sda_gpio);
+	gpio_put(sda_gpio, false);
+	gpio_init(scl_gpio);
+	gpio_pull_up(scl_gpio);
+	gpio_put(scl_gpio, false);
+
+	for (int i = 0; i < MCP23017_RECOVERY_CLOCKS && !gpio_get(sda_gpio); i++) {
+		gpio_set_dir(scl_gpio, GPIO_OUT);
+		busy_wait_us(MCP23017_RECOVERY_HALF_PERIOD_US);
+		gpio_set_dir(scl_gpio, GPIO_IN);
+		busy_wait_us(MCP23017_RECOVERY_HALF_PERIOD_US);
+	}
+	bool released = gpio_get(sda_gpio);
+
+	//stop condition, SDA rising while SCL is high
+	gpio_set_dir(scl_gpio, GPIO_OUT);
+	gpio_set_dir(sda_gpio, GPIO_OUT);
+	busy_wait_us(MCP23017_RECOVERY_HALF_PERIOD_US);
+	gpio_set_dir(scl_gpio, GPIO_IN);
+	busy_wait_us(MCP23017_RECOVERY_HALF_PERIOD_US);
+	gpio_set_dir(sda_gpio, GPIO_IN);
+	busy_wait_us(MCP23017_RECOVERY_HALF_PERIOD_US);
+
+	gpio_set_function(sda_gpio, GPIO_FUNC_I2C);
+	gpio_set_function(scl_gpio, GPIO_FUNC_I2C);
+	return released ? PICO_ERROR_NONE : MCP23017_ERROR_BUS_STUCK;
+}
+
+int mcp23017_prepare_retry(const Mcp23017_io_policy &policy, int retry, int result) {
+	uint32_t backoff = policy.backoff_us;
+	for (int i = 0; i < retry && backoff < policy.max_backoff_us; i++) {
+		backoff *= 2;
+	}
+	sleep_us(backoff < policy.max_backoff_us ? backoff : policy.max_backoff_us);
+	bool recovery = policy.sda_gpio != MCP23017_NO_GPIO && policy.scl_gpio != MCP23017_NO_GPIO;
+	if (recovery && result == MCP23017_ERROR_TIMEOUT
+		&& mcp23017_recover_bus(policy.sda_gpio, policy.scl_gpio) != PICO_ERROR_NONE) {
+		return MCP23017_ERROR_BUS_STUCK;
+	}
+	return PICO_ERROR_NONE;
+}
+
+uint32_t mcp23017_worst_case_latency_us(const Mcp23017_io_policy &policy, int transfers) {
+	bool recovery = policy.sda_gpio != MCP23017_NO_GPIO && policy.scl_gpio != MCP23017_NO_GPIO;
+	uint32_t total = policy.timeout_us * transfers;
+	uint32_t backoff = policy.backoff_us;
+	for (int retry = 0; retry < policy.retries; retry++) {
+		total += policy.timeout_us * transfers;
+		total += backoff < policy.max_backoff_us ? backoff : policy.max_backoff_us;
+		if (backoff < policy.max_backoff_us) {
+			backoff *= 2;
+		}
+		if (recovery) {
+			total += MCP23017_RECOVERY_MAX_US;
+		}
+	}
+	return total;
+}
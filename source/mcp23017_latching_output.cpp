@@ -5,19 +5,34 @@
  */
 
 #include <mcp23017_latching_output.h>
+#include <mcp23017_private.h>
 
 Mcp23017_latching_output::Mcp23017_latching_output(Mcp23017 &mcp, int off, int on)
-: _mcp_out(mcp), _off_pin(off), _on_pin(on) {
+: _mcp_out(mcp), _off_mask(mcp23017_pin_mask(off)), _on_mask(mcp23017_pin_mask(on)) {
+}
+
+Mcp23017_latching_output::Mcp23017_latching_output(Mcp23017 &mcp, int off, int on, Mcp23017_latching_scheduler &scheduler)
+: _mcp_out(mcp), _off_mask(mcp23017_pin_mask(off)), _on_mask(mcp23017_pin_mask(on)), _scheduler(&scheduler) {
+	_relay = scheduler.add_relay(mcp, off, on);
 }
 
 void Mcp23017_latching_output::set_output_state(bool desired_state) {
-	_mcp_out.set_output_bit_for_pin(_off_pin, !desired_state);
-	_mcp_out.set_output_bit_for_pin(_on_pin, desired_state);
+	if (_scheduler && _relay >= 0) {
+		_scheduler->request(_relay, desired_state);
+		return;
+	}
+	_mcp_out.write_bits(_off_mask | _on_mask, desired_state ? _on_mask : _off_mask);
 	_mcp_out.flush_output();
 }
 
 void Mcp23017_latching_output::desired_state_achieved() {
-	_mcp_out.set_output_bit_for_pin(_off_pin, false);
-	_mcp_out.set_output_bit_for_pin(_on_pin, false);
+	if (_scheduler && _relay >= 0) {
+		return; //released by the scheduler
+	}
+	if (!_mcp_out.is_output_flushed(_off_mask | _on_mask)) {
+		//still deferred by a commit scope, the coil has to be pulsed before it can be released
+		_mcp_out.flush_output_immediate();
+	}
+	_mcp_out.clear_bits(_off_mask | _on_mask);
 	_mcp_out.flush_output();
 }
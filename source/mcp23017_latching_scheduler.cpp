@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "../api/mcp23017_latching_scheduler.h"
+#include "../api/mcp23017_private.h"
+
+static_assert(MCP23017_SCHEDULER_MAX_RELAYS <= 64, "flush_devices tracks the relays in a 64 bit mask");
+
+Mcp23017_latching_scheduler::Mcp23017_latching_scheduler(uint32_t _pulse_width_us) : pulse_width_us(_pulse_width_us) {
+
+}
+
+int Mcp23017_latching_scheduler::add_relay(Mcp23017 &mcp, int off_pin, int on_pin) {
+	if (relay_count >= MCP23017_SCHEDULER_MAX_RELAYS || off_pin < 0 || off_pin > 15 || on_pin < 0 || on_pin > 15) {
+		return PICO_ERROR_GENERIC;
+	}
+	int device = 0;
+	while (device < device_count && devices[device] != &mcp) {
+		device++;
+	}
+	if (device == device_count) {
+		if (device_count >= MCP23017_SCHEDULER_MAX_DEVICES) {
+			return PICO_ERROR_GENERIC;
+		}
+		devices[device_count++] = &mcp;
+	}
+	relays[relay_count] = {&mcp, static_cast<uint8_t>(device), mcp23017_pin_mask(off_pin), mcp23017_pin_mask(on_pin),
+			false, false, false, false, 0};
+	return relay_count++;
+}
+
+int Mcp23017_latching_scheduler::request(int relay, bool state) {
+	if (relay < 0 || relay >= relay_count) {
+		return PICO_ERROR_GENERIC;
+	}
+	uint32_t status = save_and_disable_interrupts();
+	relays[relay].requested_state = state;
+	relays[relay].requested = true;
+	restore_interrupts(status);
+	return PICO_ERROR_NONE;
+}
+
+int Mcp23017_latching_scheduler::tick(uint64_t now_us) {
+	uint32_t status = save_and_disable_interrupts();
+	uint32_t devices_changed = stage(now_us) | pending_devices;
+	pending_devices = 0;
+	restore_interrupts(status);
+	return flush_devices(devices_changed, now_us);
+}
+
+int Mcp23017_latching_scheduler::service() {
+	uint32_t status = save_and_disable_interrupts();
+	uint32_t devices_changed = pending_devices;
+	pending_devices = 0;
+	restore_interrupts(status);
+	return flush_devices(devices_changed, time_us_64());
+}
+
+uint32_t Mcp23017_latching_scheduler::stage(uint64_t now_us) {
+	uint32_t devices_changed = 0;
+
+	for (int i = 0; i < relay_count; i++) {
+		Relay &relay = relays[i];
+		if (relay.pulsing && relay.set_written && now_us >= relay.release_at_us) {
+			relay.mcp->clear_bits(relay.off_mask | relay.on_mask);
+			relay.pulsing = false;
+			devices_changed |= (1u << relay.device);
+		}
+	}
+	for (int i = 0; i < relay_count; i++) {
+		Relay &relay = relays[i];
+		if (relay.requested && !relay.pulsing) {
+			relay.mcp->write_bits(relay.off_mask | relay.on_mask, relay.requested_state ? relay.on_mask : relay.off_mask);
+			relay.requested = false;
+			relay.pulsing = true;
+			relay.set_written = false; //the pulse is timed from the flush that writes it
+			devices_changed |= (1u << relay.device);
+		}
+	}
+	return devices_changed;
+}
+
+int Mcp23017_latching_scheduler::flush_devices(uint32_t devices_changed, uint64_t now_us) {
+	int result = PICO_ERROR_NONE;
+	for (int device = 0; device < device_count; device++) {
+		if ((devices_changed & (1u << device)) == 0) {
+			continue;
+		}
+		//only the set edges staged before the flush are known to be in it
+		uint64_t starting = 0;
+		uint32_t status = save_and_disable_interrupts();
+		for (int i = 0; i < relay_count; i++) {
+			if (relays[i].device == device && relays[i].pulsing && !relays[i].set_written) {
+				starting |= (1ull << i);
+			}
+		}
+		restore_interrupts(status);
+
+		if (devices[device]->flush_output() != PICO_ERROR_NONE) {
+			status = save_and_disable_interrupts();
+			pending_devices = pending_devices | (1u << device); //tried again by the next service
+			restore_interrupts(status);
+			result = PICO_ERROR_GENERIC;
+			continue;
+		}
+
+		status = save_and_disable_interrupts();
+		for (int i = 0; i < relay_count; i++) {
+			Relay &relay = relays[i];
+			if ((starting & (1ull << i)) && relay.mcp->is_output_flushed(relay.off_mask | relay.on_mask)) {
+				relay.set_written = true;
+				relay.release_at_us = now_us + pulse_width_us;
+			}
+		}
+		restore_interrupts(status);
+	}
+	return result;
+}
+
+bool Mcp23017_latching_scheduler::timer_callback(repeating_timer_t *timer) {
+	auto scheduler = static_cast<Mcp23017_latching_scheduler *>(timer->user_data);
+	scheduler->pending_devices = scheduler->pending_devices | scheduler->stage(time_us_64());
+	return true;
+}
+
+bool Mcp23017_latching_scheduler::start(uint32_t tick_us) {
+	if (timer_running) {
+		return false;
+	}
+	timer_running = add_repeating_timer_us(-static_cast<int64_t>(tick_us), timer_callback, this, &timer);
+	return timer_running;
+}
+
+void Mcp23017_latching_scheduler::stop() {
+	if (timer_running) {
+		cancel_repeating_timer(&timer);
+		timer_running = false;
+	}
+}
+
+bool Mcp23017_latching_scheduler::is_idle() const {
+	for (int i = 0; i < relay_count; i++) {
+		if (relays[i].requested || relays[i].pulsing) {
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifdef __linux__
+
+#include "../api/mcp23017_linux_transport.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#define MCP23017_LINUX_TIMEOUT_UNIT_US 10000
+
+
+Mcp23017_linux_transport::~Mcp23017_linux_transport() {
+	close();
+}
+
+int Mcp23017_linux_transport::open(int bus) {
+	close();
+	char path[32];
+	snprintf(path, sizeof(path), "/dev/i2c-%d", bus);
+	fd = ::open(path, O_RDWR);
+	mcp_debug("open %s: %d\n", path, fd);
+	return fd < 0 ? PICO_ERROR_GENERIC : PICO_ERROR_NONE;
+}
+
+void Mcp23017_linux_transport::close() {
+	if (fd >= 0) {
+		::close(fd);
+		fd = -1;
+	}
+	holding = false;
+	adapter_timeout_us = 0;
+}
+
+bool Mcp23017_linux_transport::is_open() const {
+	return fd >= 0;
+}
+
+int Mcp23017_linux_transport::write(uint8_t address, const uint8_t *src, size_t length, bool nostop, uint32_t timeout_us) {
+	if (nostop && length <= MCP23017_LINUX_HELD_MAX) {
+		int result = send_held(timeout_us);
+		if (result < PICO_ERROR_NONE) {
+			return result;
+		}
+		memcpy(held, src, length);
+		held_address = address;
+		held_length = static_cast<uint16_t>(length);
+		holding = true;
+		return static_cast<int>(length);
+	}
+	i2c_msg message{address, 0, static_cast<__u16>(length), const_cast<uint8_t *>(src)};
+	int result = transfer_with_held(message, timeout_us);
+	return result < PICO_ERROR_NONE ? result : static_cast<int>(length);
+}
+
+int Mcp23017_linux_transport::read(uint8_t address, uint8_t *dst, size_t length, bool /*nostop*/, uint32_t timeout_us) {
+	//the data is needed now so a read can't be held, it always ends with a stop
+	i2c_msg message{address, I2C_M_RD, static_cast<__u16>(length), dst};
+	int result = transfer_with_held(message, timeout_us);
+	return result < PICO_ERROR_NONE ? result : static_cast<int>(length);
+}
+
+int Mcp23017_linux_transport::control(unsigned long request, unsigned long argument) {
+	return ioctl(fd, request, argument);
+}
+
+int Mcp23017_linux_transport::transfer_with_held(i2c_msg &message, uint32_t timeout_us) {
+	i2c_msg messages[2];
+	int count = 0;
+	if (holding) {
+		messages[count++] = {held_address, 0, held_length, held};
+		holding = false;
+	}
+	messages[count++] = message;
+	return transfer(messages, count, timeout_us);
+}
+
+int Mcp23017_linux_transport::send_held(uint32_t timeout_us) {
+	if (!holding) {
+		return PICO_ERROR_NONE;
+	}
+	i2c_msg message{held_address, 0, held_length, held};
+	holding = false;
+	return transfer(&message, 1, timeout_us);
+}
+
+int Mcp23017_linux_transport::transfer(i2c_msg *messages, int count, uint32_t timeout_us) {
+	if (timeout_us != adapter_timeout_us) {
+		unsigned long units = (timeout_us + MCP23017_LINUX_TIMEOUT_UNIT_US - 1) / MCP23017_LINUX_TIMEOUT_UNIT_US;
+		if (control(I2C_TIMEOUT, units < 1 ? 1 : units) == 0) {
+			adapter_timeout_us = timeout_us;
+		}
+	}
+	i2c_rdwr_ioctl_data data{messages, static_cast<__u32>(count)};
+	if (control(I2C_RDWR, reinterpret_cast<unsigned long>(&data)) < 0) {
+		mcp_debug("I2C_RDWR to 0x%02x failed: %d\n", messages[count - 1].addr, errno);
+		return errno == ETIMEDOUT ? MCP23017_ERROR_TIMEOUT : MCP23017_ERROR_NACK;
+	}
+	return PICO_ERROR_NONE;
+}
+
+#endif //__linux__
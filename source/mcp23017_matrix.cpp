@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "../api/mcp23017_matrix.h"
+
+static uint8_t low_bits(uint8_t count) {
+	if (count < 1) {
+		count = 1;
+	}
+	return count >= 8 ? 0xff : static_cast<uint8_t>((1u << count) - 1);
+}
+
+Mcp23017_matrix::Mcp23017_matrix(Mcp23017 &_mcp, uint8_t _rows, uint8_t _columns) : mcp(_mcp),
+		rows(_rows < 1 ? 1 : (_rows > MCP23017_MATRIX_MAX_ROWS ? MCP23017_MATRIX_MAX_ROWS : _rows)),
+		row_mask(low_bits(rows)), column_mask(low_bits(_columns)) {
+	for (uint8_t row = 0; row < rows; row++) {
+		row_drives[row] = static_cast<uint8_t>(row_mask & ~(1u << row));
+	}
+}
+
+int Mcp23017_matrix::setup() {
+	int result = mcp.set_io_direction(static_cast<uint16_t>(~row_mask));
+	if (result < PICO_ERROR_NONE) {
+		return result;
+	}
+	result = mcp.set_pullup(column_mask << 8);
+	if (result < PICO_ERROR_NONE) {
+		return result;
+	}
+	mcp.write_bits(row_mask, row_mask);
+	return mcp.flush_output();
+}
+
+int Mcp23017_matrix::scan() {
+	//port A pins past the rows keep their output state through the scan
+	auto kept = static_cast<uint8_t>(mcp.get_output_bits() & ~row_mask);
+	uint8_t drives[MCP23017_MATRIX_MAX_ROWS];
+	for (uint8_t row = 0; row < rows; row++) {
+		drives[row] = kept | row_drives[row];
+	}
+	uint8_t columns[MCP23017_MATRIX_MAX_ROWS];
+	int result = mcp.scan_matrix(drives, columns, rows);
+	if (result < PICO_ERROR_NONE) {
+		return result;
+	}
+
+	uint8_t row_keys[MCP23017_MATRIX_MAX_ROWS]{};
+	uint64_t keys = 0;
+	for (uint8_t row = 0; row < rows; row++) {
+		row_keys[row] = ~columns[row] & column_mask; //a key down pulls its column low
+		keys |= static_cast<uint64_t>(row_keys[row]) << mcp23017_key(row, 0);
+	}
+	raw_keys = keys;
+	ghosted = has_ghost(row_keys);
+	if (ghosted) {
+		ghost_count++;
+		return 0;
+	}
+
+	uint64_t changed = debouncer.update(keys);
+	uint64_t stable = debouncer.get_stable();
+	uint64_t now_us = time_us_64();
+	int event_count = 0;
+	while (changed) {
+		int key = __builtin_ctzll(changed);
+		changed &= changed - 1;
+		events.push({now_us, static_cast<uint8_t>(key), ((stable >> key) & 1) != 0});
+		event_count++;
+	}
+	return event_count;
+}
+
+bool Mcp23017_matrix::has_ghost(const uint8_t *row_keys) const {
+	for (uint8_t row = 0; row < rows; row++) {
+		if ((row_keys[row] & (row_keys[row] - 1)) == 0) {
+			continue; //fewer than two keys in this row
+		}
+		for (uint8_t other = row + 1; other < rows; other++) {
+			uint8_t shared = row_keys[row] & row_keys[other];
+			if (shared & (shared - 1)) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+bool Mcp23017_matrix::pop_event(Mcp23017_key_event &event) {
+	return events.pop(event);
+}
+
+void Mcp23017_matrix::set_debounce_depth(uint8_t depth) {
+	debouncer.set_depth(depth);
+}
+
+uint64_t Mcp23017_matrix::get_keys() const {
+	return debouncer.get_stable();
+}
+
+uint64_t Mcp23017_matrix::get_raw_keys() const {
+	return raw_keys;
+}
+
+bool Mcp23017_matrix::is_pressed(int key) const {
+	return key >= 0 && key < MCP23017_MATRIX_MAX_ROWS * MCP23017_MATRIX_MAX_COLUMNS && ((get_keys() >> key) & 1);
+}
+
+bool Mcp23017_matrix::is_ghosted() const {
+	return ghosted;
+}
+
+uint32_t Mcp23017_matrix::get_ghost_count() const {
+	return ghost_count;
+}
+
+uint32_t Mcp23017_matrix::get_overflow_count() const {
+	return events.get_overflow_count();
+}
@@ -0,0 +1,161 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "../api/mcp23017_mux.h"
+
+
+int Mcp23017_mux_channel::write(uint8_t address, const uint8_t *src, size_t length, bool nostop, uint32_t timeout_us) {
+	int result = mux->select(channel, timeout_us);
+	if (result < PICO_ERROR_NONE) {
+		return result;
+	}
+	return mux->upstream->write(address, src, length, nostop, timeout_us);
+}
+
+int Mcp23017_mux_channel::read(uint8_t address, uint8_t *dst, size_t length, bool nostop, uint32_t timeout_us) {
+	int result = mux->select(channel, timeout_us);
+	if (result < PICO_ERROR_NONE) {
+		return result;
+	}
+	return mux->upstream->read(address, dst, length, nostop, timeout_us);
+}
+
+int Mcp23017_mux_channel::get_channel() const {
+	return channel;
+}
+
+Mcp23017_mux::Mcp23017_mux(i2c_inst_t *i2c, uint8_t _address) : pico_transport(i2c), upstream(&pico_transport),
+		address(_address) {
+	init_channels();
+}
+
+Mcp23017_mux::Mcp23017_mux(Mcp23017_transport &_upstream, uint8_t _address) : pico_transport(nullptr),
+		upstream(&_upstream), address(_address) {
+	init_channels();
+}
+
+void Mcp23017_mux::init_channels() {
+	for (int i = 0; i < MCP23017_MUX_CHANNELS; i++) {
+		channels[i].mux = this;
+		channels[i].channel = i;
+	}
+}
+
+Mcp23017_mux_channel &Mcp23017_mux::get_channel(int channel) {
+	channel = channel < 0 ? 0 : (channel >= MCP23017_MUX_CHANNELS ? MCP23017_MUX_CHANNELS - 1 : channel);
+	return channels[channel];
+}
+
+int Mcp23017_mux::select(int channel, uint32_t timeout_us) {
+	if (channel != MCP23017_MUX_NO_CHANNEL && (channel < 0 || channel >= MCP23017_MUX_CHANNELS)) {
+		return PICO_ERROR_GENERIC;
+	}
+	if (channel == selected) {
+		return PICO_ERROR_NONE;
+	}
+	//the TCA9548A switches on the stop, so this can't be chained to the transfer that follows
+	uint8_t control = channel == MCP23017_MUX_NO_CHANNEL ? 0x00 : static_cast<uint8_t>(1u << channel);
+	int result = upstream->write(address, &control, 1, false, timeout_us);
+	mcp_debug("mux select %d: %d\n", channel, result);
+	select_count++;
+	if (result < PICO_ERROR_NONE) {
+		selected = MCP23017_MUX_UNKNOWN_CHANNEL;
+		return result;
+	}
+	selected = channel;
+	return PICO_ERROR_NONE;
+}
+
+int Mcp23017_mux::get_selected_channel() const {
+	return selected;
+}
+
+void Mcp23017_mux::invalidate_selection() {
+	selected = MCP23017_MUX_UNKNOWN_CHANNEL;
+}
+
+uint32_t Mcp23017_mux::get_select_count() const {
+	return select_count;
+}
+
+int Mcp23017_mux::find_channel(const Mcp23017 &mcp) const {
+	for (int i = 0; i < MCP23017_MUX_CHANNELS; i++) {
+		if (mcp.get_transport().get_bus() == channels[i].get_bus()) {
+			return i;
+		}
+	}
+	return MCP23017_MUX_NO_CHANNEL;
+}
+
+int Mcp23017_mux::add_device(Mcp23017 &mcp) {
+	int channel = find_channel(mcp);
+	if (device_count >= MCP23017_MUX_MAX_DEVICES || channel == MCP23017_MUX_NO_CHANNEL) {
+		return PICO_ERROR_GENERIC;
+	}
+	for (int i = 0; i < device_count; i++) {
+		if (device_channels[i] == channel && devices[i]->get_address() == mcp.get_address()) {
+			return PICO_ERROR_GENERIC;
+		}
+	}
+	devices[device_count] = &mcp;
+	device_channels[device_count] = static_cast<int8_t>(channel);
+	return device_count++;
+}
+
+int Mcp23017_mux::first_channel() const {
+	return selected >= 0 ? selected : 0;
+}
+
+int Mcp23017_mux::poll_all() {
+	int result = PICO_ERROR_NONE;
+	int first = first_channel();
+	for (int step = 0; step < MCP23017_MUX_CHANNELS; step++) {
+		int channel = (first + step) % MCP23017_MUX_CHANNELS;
+		Mcp23017_bus bus(channels[channel]);
+		for (int i = 0; i < device_count; i++) {
+			if (device_channels[i] == channel) {
+				bus.add_device(*devices[i]);
+			}
+		}
+		if (bus.get_device_count() == 0) {
+			continue;
+		}
+		int poll_result = bus.poll_all();
+		if (poll_result != PICO_ERROR_NONE) {
+			result = poll_result;
+		}
+	}
+	return result;
+}
+
+int Mcp23017_mux::flush_all() {
+	int result = PICO_ERROR_NONE;
+	int first = first_channel();
+	for (int step = 0; step < MCP23017_MUX_CHANNELS; step++) {
+		int channel = (first + step) % MCP23017_MUX_CHANNELS;
+		for (int i = 0; i < device_count; i++) {
+			if (device_channels[i] != channel) {
+				continue;
+			}
+			int flush_result = devices[i]->flush_output();
+			if (flush_result != PICO_ERROR_NONE) {
+				result = flush_result;
+			}
+		}
+	}
+	return result;
+}
+
+int Mcp23017_mux::get_device_count() const {
+	return device_count;
+}
+
+Mcp23017 *Mcp23017_mux::get_device(int index) const {
+	if (index < 0 || index >= device_count) {
+		return nullptr;
+	}
+	return devices[index];
+}
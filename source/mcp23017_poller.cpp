@@ -0,0 +1,113 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "../api/mcp23017_poller.h"
+
+
+Mcp23017_poller::Mcp23017_poller(uint32_t _min_period_us, uint32_t _max_period_us) :
+		min_period_us(_min_period_us), max_period_us(_max_period_us < _min_period_us ? _min_period_us : _max_period_us) {
+
+}
+
+int Mcp23017_poller::add_device(Mcp23017 &mcp, uint32_t latency_target_us) {
+	if (device_count >= MCP23017_POLLER_MAX_DEVICES) {
+		return PICO_ERROR_GENERIC;
+	}
+	uint32_t device_max_us = max_period_us;
+	if (latency_target_us != 0 && latency_target_us < device_max_us) {
+		device_max_us = latency_target_us < min_period_us ? min_period_us : latency_target_us;
+	}
+	devices[device_count] = {&mcp, device_max_us, min_period_us, 0, 0, false};
+	return device_count++;
+}
+
+void Mcp23017_poller::set_handler(mcp23017_poll_handler _handler, void *context) {
+	handler = _handler;
+	handler_context = context;
+}
+
+int Mcp23017_poller::poll(uint64_t now_us) {
+	int changed_count = 0;
+	int error = PICO_ERROR_NONE;
+	for (int i = 0; i < device_count; i++) {
+		Device &device = devices[i];
+		if (now_us < device.next_poll_us) {
+			continue;
+		}
+		poll_count++;
+		int result = device.mcp->update_and_get_input_values();
+		if (result != PICO_ERROR_NONE) {
+			device.next_poll_us = now_us + device.period_us;
+			error = result;
+			continue;
+		}
+		uint16_t inputs = device.mcp->get_last_input_pin_values();
+		uint16_t changed = device.seeded ? inputs ^ device.previous : 0;
+		device.previous = inputs;
+		device.seeded = true;
+		if (changed != 0) {
+			device.period_us = min_period_us;
+			changed_count++;
+			if (handler) {
+				handler(*device.mcp, changed, handler_context);
+			}
+		} else if (device.period_us < device.max_period_us) {
+			device.period_us = device.period_us > device.max_period_us / 2 ? device.max_period_us : device.period_us * 2;
+		}
+		device.next_poll_us = now_us + device.period_us;
+	}
+	return error != PICO_ERROR_NONE ? error : changed_count;
+}
+
+uint64_t Mcp23017_poller::get_next_poll_us() const {
+	uint64_t next = UINT64_MAX;
+	for (int i = 0; i < device_count; i++) {
+		if (devices[i].next_poll_us < next) {
+			next = devices[i].next_poll_us;
+		}
+	}
+	return next;
+}
+
+uint32_t Mcp23017_poller::get_period_us(int device) const {
+	if (device < 0 || device >= device_count) {
+		return 0;
+	}
+	return devices[device].period_us;
+}
+
+uint32_t Mcp23017_poller::get_poll_count() const {
+	return poll_count;
+}
+
+bool Mcp23017_poller::timer_callback(repeating_timer_t *timer) {
+	auto poller = static_cast<Mcp23017_poller *>(timer->user_data);
+	poller->tick_pending = true;
+	return true;
+}
+
+int Mcp23017_poller::service() {
+	if (!tick_pending) {
+		return 0;
+	}
+	tick_pending = false;
+	return poll(time_us_64());
+}
+
+bool Mcp23017_poller::start(uint32_t tick_us) {
+	if (timer_running) {
+		return false;
+	}
+	timer_running = add_repeating_timer_us(-static_cast<int64_t>(tick_us), timer_callback, this, &timer);
+	return timer_running;
+}
+
+void Mcp23017_poller::stop() {
+	if (timer_running) {
+		cancel_repeating_timer(&timer);
+		timer_running = false;
+	}
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include "../api/mcp23017_transaction.h"
+
+#ifdef MOCK_PICO_PI
+#include "../test/pico_pi_mocks.h"
+#else
+#include "hardware/sync.h"
+#endif
+
+
+Mcp23017_transaction_queue::Mcp23017_transaction_queue(i2c_inst_t *_i2c) : i2c(_i2c) {
+
+}
+
+int Mcp23017_transaction_queue::submit(Mcp23017_transaction &transaction) {
+	if (transaction.busy || transaction.length > MCP23017_TRANSACTION_MAX_DATA) {
+		return PICO_ERROR_GENERIC;
+	}
+	transaction.busy = true;
+	transaction.result = PICO_ERROR_NONE;
+	transaction.next = nullptr;
+
+	uint32_t status = save_and_disable_interrupts();
+	bool was_idle = head == nullptr;
+	if (was_idle) {
+		head = &transaction;
+	} else {
+		tail->next = &transaction;
+	}
+	tail = &transaction;
+	restore_interrupts(status);
+
+	if (was_idle) {
+		mcp23017_port_start(*this, transaction);
+	}
+	return PICO_ERROR_NONE;
+}
+
+bool Mcp23017_transaction_queue::is_idle() const {
+	return head == nullptr;
+}
+
+i2c_inst_t *Mcp23017_transaction_queue::get_i2c() const {
+	return i2c;
+}
+
+void Mcp23017_transaction_queue::transaction_finished(int result) {
+	uint32_t status = save_and_disable_interrupts();
+	Mcp23017_transaction *finished = head;
+	if (finished == nullptr) {
+		restore_interrupts(status);
+		return;
+	}
+	head = finished->next;
+	if (head == nullptr) {
+		tail = nullptr;
+	}
+	Mcp23017_transaction *next = head;
+	restore_interrupts(status);
+
+	finished->result = result;
+	if (finished->device) {
+		finished->device->transaction_complete(*finished);
+	}
+	finished->busy = false;
+	if (finished->callback) {
+		finished->callback(*finished, finished->context);
+	}
+
+	if (next) {
+		mcp23017_port_start(*this, *next);
+	}
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MOCK_PICO_PI
+
+#include "../api/mcp23017_transaction.h"
+#include "hardware/i2c.h"
+#include "hardware/irq.h"
+
+#define MCP23017_PORT_FIFO_DEPTH 16
+
+/**
+ * Interrupt driven RP2040 i2c port, the FIFOs are topped up from the interrupt so the core is free during the transfer
+ */
+struct Mcp23017_port_state {
+	Mcp23017_transaction_queue *queue;
+	Mcp23017_transaction *transaction;
+	uint8_t commands_total;
+	uint8_t commands_sent;
+	uint8_t bytes_read;
+	bool aborted;
+	bool handler_installed;
+};
+
+static Mcp23017_port_state port_states[NUM_I2CS];
+
+/**
+ * Tops up the tx fifo
+ * @return true if more commands can be sent once the tx fifo empties, false when done or throttled by the rx fifo
+ */
+static bool port_fill_tx_fifo(i2c_hw_t *hw, Mcp23017_port_state &state) {
+	Mcp23017_transaction &transaction = *state.transaction;
+	bool throttled = false;
+	while (state.commands_sent < state.commands_total && hw->txflr < MCP23017_PORT_FIFO_DEPTH) {
+		uint8_t index = state.commands_sent;
+		bool last = index + 1 == state.commands_total;
+		uint32_t command;
+		if (index == 0) {
+			command = transaction.reg;
+		} else if (transaction.read) {
+			//don't ask for more bytes than the rx fifo can hold
+			if (index - 1 - state.bytes_read >= MCP23017_PORT_FIFO_DEPTH) {
+				throttled = true;
+				break;
+			}
+			command = I2C_IC_DATA_CMD_CMD_BITS;
+			if (index == 1) {
+				command |= I2C_IC_DATA_CMD_RESTART_BITS;
+			}
+		} else {
+			command = transaction.data[index - 1];
+		}
+		if (last) {
+			command |= I2C_IC_DATA_CMD_STOP_BITS;
+		}
+		hw->data_cmd = command;
+		state.commands_sent++;
+	}
+	return !throttled && state.commands_sent < state.commands_total;
+}
+
+static void port_refill_tx_fifo(i2c_hw_t *hw, Mcp23017_port_state &state) {
+	//tx empty stays masked while throttled, it would fire continuously, draining the rx fifo re-enables it
+	if (port_fill_tx_fifo(hw, state)) {
+		hw_set_bits(&hw->intr_mask, I2C_IC_INTR_MASK_M_TX_EMPTY_BITS);
+	} else {
+		hw_clear_bits(&hw->intr_mask, I2C_IC_INTR_MASK_M_TX_EMPTY_BITS);
+	}
+}
+
+static void port_drain_rx_fifo(i2c_hw_t *hw, Mcp23017_port_state &state) {
+	Mcp23017_transaction &transaction = *state.transaction;
+	while (hw->rxflr > 0) {
+		auto value = static_cast<uint8_t>(hw->data_cmd);
+		if (state.bytes_read < transaction.length) {
+			transaction.data[state.bytes_read++] = value;
+		}
+	}
+}
+
+static void port_irq(uint index) {
+	Mcp23017_port_state &state = port_states[index];
+	i2c_hw_t *hw = i2c_get_hw(i2c_get_instance(index));
+	uint32_t status = hw->intr_stat;
+
+	if (state.transaction == nullptr) {
+		hw->intr_mask = 0;
+		return;
+	}
+	if (status & I2C_IC_INTR_STAT_R_TX_ABRT_BITS) {
+		hw->clr_tx_abrt;
+		state.aborted = true;
+	}
+	if (status & I2C_IC_INTR_STAT_R_RX_FULL_BITS) {
+		port_drain_rx_fifo(hw, state);
+	}
+	if ((status & (I2C_IC_INTR_STAT_R_TX_EMPTY_BITS | I2C_IC_INTR_STAT_R_RX_FULL_BITS)) && !state.aborted) {
+		port_refill_tx_fifo(hw, state);
+	}
+	if (status & I2C_IC_INTR_STAT_R_STOP_DET_BITS) {
+		hw->clr_stop_det;
+		port_drain_rx_fifo(hw, state);
+		hw->intr_mask = 0;
+		bool ok = !state.aborted && (!state.transaction->read || state.bytes_read == state.transaction->length);
+		Mcp23017_transaction_queue *queue = state.queue;
+		state.transaction = nullptr;
+		queue->transaction_finished(ok ? PICO_ERROR_NONE : PICO_ERROR_GENERIC);
+	}
+}
+
+static void port_irq_i2c0() {
+	port_irq(0);
+}
+
+static void port_irq_i2c1() {
+	port_irq(1);
+}
+
+void mcp23017_port_start(Mcp23017_transaction_queue &queue, Mcp23017_transaction &transaction) {
+	i2c_inst_t *i2c = queue.get_i2c();
+	uint index = i2c_hw_index(i2c);
+	i2c_hw_t *hw = i2c_get_hw(i2c);
+	Mcp23017_port_state &state = port_states[index];
+
+	if (!state.handler_installed) {
+		irq_set_exclusive_handler(I2C0_IRQ + index, index == 0 ? port_irq_i2c0 : port_irq_i2c1);
+		irq_set_enabled(I2C0_IRQ + index, true);
+		state.handler_installed = true;
+	}
+
+	state.queue = &queue;
+	state.transaction = &transaction;
+	state.commands_total = 1 + transaction.length;
+	state.commands_sent = 0;
+	state.bytes_read = 0;
+	state.aborted = false;
+
+	hw->enable = 0;
+	hw->tar = transaction.address;
+	hw->rx_tl = 0;
+	hw->tx_tl = 0;
+	hw->enable = 1;
+	hw->clr_intr;
+
+	bool more = port_fill_tx_fifo(hw, state);
+	hw->intr_mask = I2C_IC_INTR_MASK_M_TX_ABRT_BITS | I2C_IC_INTR_MASK_M_STOP_DET_BITS |
+			(transaction.read ? I2C_IC_INTR_MASK_M_RX_FULL_BITS : 0) |
+			(more ? I2C_IC_INTR_MASK_M_TX_EMPTY_BITS : 0);
+}
+
+#endif //MOCK_PICO_PI
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "mcp23017.h"
+#include "mcp23017_bus.h"
+#include "mcp23017_matrix.h"
+#include "mcp23017_private.h"
+#include "mcp23017_simulator.h"
+
+/**
+ * Bus cost of each public Mcp23017 operation and of common sequences, measured against the simulator
+ *
+ * Each benchmark gets freshly reset devices, prepare() runs unmeasured, then run() is measured.
+ * Output is one row per benchmark so that results can be diffed between builds to catch regressions.
+ */
+
+static i2c_inst_t bench_i2c{};
+
+static const int MCP_ALL_PINS_INPUT = 0xffff;
+static const int MCP_ALL_PINS_OUTPUT = 0x0000;
+static const int MCP_ALL_PINS_PULL_UP = 0xffff;
+static const int MCP_ALL_PINS_COMPARE_TO_LAST = 0x0000;
+static const int MCP_ALL_PINS_INTERRUPT_ENABLED = 0xffff;
+static const int BENCH_DEVICES = MCP23017_BUS_MAX_DEVICES;
+
+struct Bench_context {
+	std::vector<std::unique_ptr<Mcp23017_simulator>> chips;
+	std::vector<std::unique_ptr<Mcp23017>> devices;
+	Mcp23017 &mcp() { return *devices[0]; }
+	Mcp23017_simulator &chip() { return *chips[0]; }
+};
+
+struct Benchmark {
+	const char *name;
+	void (*prepare)(Bench_context &context);
+	void (*run)(Bench_context &context);
+};
+
+static Mcp23017_config readme_input_config() {
+	Mcp23017_config config;
+	config.mirroring = true;
+	config.io_direction = MCP_ALL_PINS_INPUT;
+	config.pullup = MCP_ALL_PINS_PULL_UP;
+	config.interrupt_control = MCP_ALL_PINS_COMPARE_TO_LAST;
+	config.interrupt_enable = MCP_ALL_PINS_INTERRUPT_ENABLED;
+	return config;
+}
+
+static void no_prepare(Bench_context &) {
+}
+
+static void prepare_outputs(Bench_context &context) {
+	context.mcp().set_io_direction(MCP_ALL_PINS_OUTPUT);
+	context.mcp().set_all_output_bits(0x0000);
+}
+
+static void prepare_interrupt(Bench_context &context) {
+	context.mcp().apply(readme_input_config());
+	context.chip().set_input_levels(0x0002);
+}
+
+static void latching_toggle(Mcp23017 &mcp, int off_pin, int on_pin, bool state) {
+	//as Mcp23017_latching_output::set_output_state then desired_state_achieved
+	mcp.set_output_bit_for_pin(off_pin, !state);
+	mcp.set_output_bit_for_pin(on_pin, state);
+	mcp.flush_output();
+	mcp.set_output_bit_for_pin(off_pin, false);
+	mcp.set_output_bit_for_pin(on_pin, false);
+	mcp.flush_output();
+}
+
+static const Benchmark benchmarks[] = {
+		{"setup", no_prepare, [](Bench_context &c) { c.mcp().setup(true, false); }},
+		{"set_io_direction", no_prepare, [](Bench_context &c) { c.mcp().set_io_direction(MCP_ALL_PINS_INPUT); }},
+		{"set_io_direction unchanged", [](Bench_context &c) { c.mcp().set_io_direction(MCP_ALL_PINS_INPUT); },
+				[](Bench_context &c) { c.mcp().set_io_direction(MCP_ALL_PINS_INPUT); }},
+		{"set_pullup", no_prepare, [](Bench_context &c) { c.mcp().set_pullup(MCP_ALL_PINS_PULL_UP); }},
+		{"set_interrupt_type", no_prepare, [](Bench_context &c) { c.mcp().set_interrupt_type(MCP_ALL_PINS_COMPARE_TO_LAST); }},
+		{"enable_interrupt", no_prepare, [](Bench_context &c) { c.mcp().enable_interrupt(MCP_ALL_PINS_INTERRUPT_ENABLED); }},
+		{"apply", no_prepare, [](Bench_context &c) { c.mcp().apply(readme_input_config()); }},
+		{"get_last_interrupt_pin", prepare_interrupt, [](Bench_context &c) { c.mcp().get_last_interrupt_pin(); }},
+		{"get_interrupt_values", prepare_interrupt, [](Bench_context &c) { c.mcp().get_interrupt_values(); }},
+		{"update_and_get_input_values", no_prepare, [](Bench_context &c) { c.mcp().update_and_get_input_values(); }},
+		{"service_interrupt", prepare_interrupt, [](Bench_context &c) {
+			Mcp23017_interrupt_state state{};
+			c.mcp().service_interrupt(state);
+		}},
+		{"set_all_output_bits", prepare_outputs, [](Bench_context &c) { c.mcp().set_all_output_bits(0xaaaa); }},
+		{"flush_output one port", prepare_outputs, [](Bench_context &c) {
+			c.mcp().set_output_bit_for_pin(4, true);
+			c.mcp().flush_output();
+		}},
+		{"flush_output unchanged", prepare_outputs, [](Bench_context &c) { c.mcp().flush_output(); }},
+		{"resync_registers", [](Bench_context &c) {
+			c.mcp().apply(readme_input_config());
+			c.mcp().invalidate_registers();
+		}, [](Bench_context &c) { c.mcp().resync_registers(); }},
+		{"README input setup", no_prepare, [](Bench_context &c) {
+			c.mcp().setup(true, false);
+			c.mcp().set_io_direction(MCP_ALL_PINS_INPUT);
+			c.mcp().set_pullup(MCP_ALL_PINS_PULL_UP);
+			c.mcp().set_interrupt_type(MCP_ALL_PINS_COMPARE_TO_LAST);
+			c.mcp().enable_interrupt(MCP_ALL_PINS_INTERRUPT_ENABLED);
+			c.mcp().get_interrupt_values();
+		}},
+		{"README input setup with apply", no_prepare, [](Bench_context &c) {
+			c.mcp().apply(readme_input_config());
+			c.mcp().get_interrupt_values();
+		}},
+		{"interrupt round, three reads", prepare_interrupt, [](Bench_context &c) {
+			c.mcp().get_last_interrupt_pin();
+			c.mcp().get_interrupt_values();
+			c.mcp().update_and_get_input_values();
+		}},
+		{"interrupt round, service_interrupt", prepare_interrupt, [](Bench_context &c) {
+			Mcp23017_interrupt_state state{};
+			c.mcp().service_interrupt(state);
+		}},
+		{"latching output toggle", prepare_outputs, [](Bench_context &c) { latching_toggle(c.mcp(), 0, 1, true); }},
+		{"64 output words, flush_output", prepare_outputs, [](Bench_context &c) {
+			for (int i = 0; i < 64; i++) {
+				c.mcp().set_all_output_bits(0x0101 << (i % 8));
+			}
+		}},
+		{"64 output words, stream_output", prepare_outputs, [](Bench_context &c) {
+			uint16_t words[64];
+			for (int i = 0; i < 64; i++) {
+				words[i] = 0x0101 << (i % 8);
+			}
+			c.mcp().stream_output(words, 64);
+		}},
+		{"64 input samples, one at a time", no_prepare, [](Bench_context &c) {
+			for (int i = 0; i < 64; i++) {
+				c.mcp().update_and_get_input_values();
+			}
+		}},
+		{"64 input samples, stream_input", no_prepare, [](Bench_context &c) {
+			c.mcp().stream_input(64, [](const uint16_t *, size_t, uint64_t, uint64_t, void *) {}, nullptr);
+		}},
+		{"8x8 matrix scan, output then input", prepare_outputs, [](Bench_context &c) {
+			for (int row = 0; row < 8; row++) {
+				c.mcp().set_all_output_bits(0xff & ~(1 << row));
+				c.mcp().update_and_get_input_values();
+			}
+		}},
+		{"8x8 matrix scan, Mcp23017_matrix", [](Bench_context &c) {
+			Mcp23017_matrix(c.mcp()).setup();
+		}, [](Bench_context &c) {
+			Mcp23017_matrix matrix(c.mcp());
+			matrix.scan();
+		}},
+		{"8 device poll, one at a time", no_prepare, [](Bench_context &c) {
+			for (auto &device : c.devices) {
+				device->update_and_get_input_values();
+			}
+		}},
+		{"8 device poll, bus poll_all", no_prepare, [](Bench_context &c) {
+			Mcp23017_bus bus(&bench_i2c);
+			for (auto &device : c.devices) {
+				bus.add_device(*device);
+			}
+			bus.poll_all();
+		}},
+};
+
+int main(int argc, char *argv[]) {
+	const uint32_t clocks[] = {100000, 400000, 1000000};
+
+	printf("%-36s %6s %6s %6s %6s %10s %10s %10s\n", "operation", "trans", "bytes", "starts", "stops",
+		   "us@100k", "us@400k", "us@1M");
+	for (const auto &benchmark : benchmarks) {
+		if (argc > 1 && strstr(benchmark.name, argv[1]) == nullptr) {
+			continue;
+		}
+		reset_for_test(&bench_i2c);
+		Bench_context context;
+		for (int i = 0; i < BENCH_DEVICES; i++) {
+			context.chips.push_back(std::make_unique<Mcp23017_simulator>(&bench_i2c, MCP23017_BUS_FIRST_ADDRESS + i));
+			context.devices.push_back(std::make_unique<Mcp23017>(&bench_i2c, MCP23017_BUS_FIRST_ADDRESS + i));
+		}
+		benchmark.prepare(context);
+		reset_bus_stats();
+		benchmark.run(context);
+
+		printf("%-36s %6u %6u %6u %6u %10.1f %10.1f %10.1f\n", benchmark.name, mock_bus_stats.transactions,
+			   mock_bus_stats.bytes, mock_bus_stats.starts, mock_bus_stats.stops,
+			   mock_bus_time_us(clocks[0]), mock_bus_time_us(clocks[1]), mock_bus_time_us(clocks[2]));
+	}
+	return 0;
+}
@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include "mcp23017_simulator.h"
+
+#define IOCON_BANK 0x80
+#define IOCON_MIRROR 0x40
+#define IOCON_SEQOP 0x20
+#define BANK0_LAST_ADDRESS 0x15
+#define BANK1_PORT_OFFSET 0x10
+
+static std::vector<Mcp23017_simulator *> simulators;
+
+Mcp23017_simulator *find_simulator(const i2c_inst_t *i2c, uint8_t address) {
+	for (auto simulator : simulators) {
+		if (simulator->get_i2c() == i2c && simulator->get_address() == address) {
+			return simulator;
+		}
+	}
+	return nullptr;
+}
+
+Mcp23017_simulator::Mcp23017_simulator(i2c_inst_t *_i2c, uint8_t _address) : i2c(_i2c), address(_address) {
+	reset();
+	simulators.push_back(this);
+}
+
+Mcp23017_simulator::~Mcp23017_simulator() {
+	simulators.erase(std::remove(simulators.begin(), simulators.end(), this), simulators.end());
+}
+
+void Mcp23017_simulator::reset() {
+	for (auto &reg : registers) {
+		reg[0] = 0;
+		reg[1] = 0;
+	}
+	registers[IODIR][0] = 0xff;
+	registers[IODIR][1] = 0xff;
+	pointer = 0;
+}
+
+bool Mcp23017_simulator::decode(uint8_t address_pointer, int &reg, int &port) const {
+	if (registers[IOCON][0] & IOCON_BANK) {
+		port = (address_pointer & BANK1_PORT_OFFSET) ? 1 : 0;
+		reg = address_pointer & 0x0f;
+		return address_pointer < 2 * BANK1_PORT_OFFSET && reg < REGISTERS;
+	}
+	reg = address_pointer / 2;
+	port = address_pointer & 1;
+	return address_pointer <= BANK0_LAST_ADDRESS;
+}
+
+void Mcp23017_simulator::advance_pointer() {
+	bool bank1 = registers[IOCON][0] & IOCON_BANK;
+	if (registers[IOCON][0] & IOCON_SEQOP) {
+		//byte mode, BANK=0 toggles within the A/B pair, BANK=1 stays put
+		if (!bank1) {
+			pointer ^= 1;
+		}
+		return;
+	}
+	pointer++;
+	if (bank1) {
+		if ((pointer & 0x0f) >= REGISTERS) {
+			pointer = (pointer & BANK1_PORT_OFFSET) ? 0 : BANK1_PORT_OFFSET;
+		}
+	} else if (pointer > BANK0_LAST_ADDRESS) {
+		pointer = 0;
+	}
+}
+
+uint8_t Mcp23017_simulator::port_value(int port) const {
+	uint8_t direction = registers[IODIR][port];
+	auto levels = static_cast<uint8_t>(input_levels >> (port * 8));
+	uint8_t inputs = (levels ^ registers[IPOL][port]) & direction;
+	return inputs | (registers[OLAT][port] & ~direction);
+}
+
+void Mcp23017_simulator::check_interrupts(int port, uint8_t previous) {
+	uint8_t current = port_value(port);
+	uint8_t enabled = registers[GPINTEN][port] & registers[IODIR][port];
+	uint8_t compare = registers[INTCON][port];
+	uint8_t triggered = enabled & ((compare & (current ^ registers[DEFVAL][port])) | (~compare & (current ^ previous)));
+	if (triggered && registers[INTF][port] == 0) {
+		registers[INTF][port] = triggered;
+		registers[INTCAP][port] = current;
+	}
+}
+
+void Mcp23017_simulator::write_register(int reg, int port, uint8_t value) {
+	uint8_t previous = port_value(port);
+	switch (reg) {
+		case IOCON:
+			registers[IOCON][0] = value;
+			registers[IOCON][1] = value;
+			return;
+		case INTF:
+		case INTCAP:
+			return; //read only
+		case GPIO:
+		case OLAT:
+			registers[OLAT][port] = value;
+			if (output_log) {
+				output_log->push_back(registers[OLAT][0] | (registers[OLAT][1] << 8));
+			}
+			return;
+		default:
+			registers[reg][port] = value;
+	}
+	if (reg == IODIR || reg == IPOL || reg == GPINTEN || reg == DEFVAL || reg == INTCON) {
+		check_interrupts(port, previous);
+	}
+}
+
+uint8_t Mcp23017_simulator::read_register(int reg, int port) {
+	uint8_t value;
+	switch (reg) {
+		case GPIO:
+			if (input_model) {
+				auto outputs = static_cast<uint16_t>(~(registers[IODIR][0] | (registers[IODIR][1] << 8)));
+				set_input_levels(input_model(get_pin_levels(), outputs, input_model_context));
+			}
+			value = port_value(port);
+			break;
+		case INTCAP:
+			value = registers[INTCAP][port];
+			break;
+		default:
+			return registers[reg][port];
+	}
+	//reading GPIO or INTCAP clears the interrupt, compare to DEFVAL raises it again while the condition holds
+	registers[INTF][port] = 0;
+	check_interrupts(port, port_value(port));
+	if (reg == GPIO && port == 1 && next_input < input_sequence.size()) {
+		set_input_levels(input_sequence[next_input++]);
+	}
+	return value;
+}
+
+void Mcp23017_simulator::set_input_levels(uint16_t levels) {
+	uint8_t previous[] = {port_value(0), port_value(1)};
+	input_levels = levels;
+	check_interrupts(0, previous[0]);
+	check_interrupts(1, previous[1]);
+}
+
+uint16_t Mcp23017_simulator::get_pin_levels() const {
+	uint16_t levels = 0;
+	for (int port = 0; port < 2; port++) {
+		uint8_t direction = registers[IODIR][port];
+		auto driven = static_cast<uint8_t>(input_levels >> (port * 8));
+		uint8_t value = (driven & direction) | (registers[OLAT][port] & ~direction);
+		levels |= value << (port * 8);
+	}
+	return levels;
+}
+
+bool Mcp23017_simulator::is_interrupt_asserted(int port) const {
+	if (registers[IOCON][0] & IOCON_MIRROR) {
+		return registers[INTF][0] || registers[INTF][1];
+	}
+	return registers[INTF][port & 1] != 0;
+}
+
+uint8_t Mcp23017_simulator::peek(uint8_t reg) const {
+	if (reg > BANK0_LAST_ADDRESS) {
+		return 0;
+	}
+	return registers[reg / 2][reg & 1];
+}
+
+uint16_t Mcp23017_simulator::peek_pair(uint8_t reg) const {
+	return peek(reg) | (peek(reg + 1) << 8);
+}
+
+void Mcp23017_simulator::set_output_log(std::vector<uint16_t> *log) {
+	output_log = log;
+}
+
+void Mcp23017_simulator::set_input_sequence(const std::vector<uint16_t> &levels) {
+	input_sequence = levels;
+	next_input = 0;
+}
+
+void Mcp23017_simulator::set_input_model(mcp23017_simulator_input_model model, void *context) {
+	input_model = model;
+	input_model_context = context;
+}
+
+uint8_t Mcp23017_simulator::get_address() const {
+	return address;
+}
+
+i2c_inst_t *Mcp23017_simulator::get_i2c() const {
+	return i2c;
+}
+
+void Mcp23017_simulator::write(const uint8_t *src, size_t len) {
+	if (len == 0) {
+		return;
+	}
+	pointer = src[0];
+	for (size_t i = 1; i < len; i++) {
+		int reg, port;
+		if (decode(pointer, reg, port)) {
+			write_register(reg, port, src[i]);
+		}
+		advance_pointer();
+	}
+}
+
+void Mcp23017_simulator::read(uint8_t *dst, size_t len) {
+	for (size_t i = 0; i < len; i++) {
+		int reg, port;
+		dst[i] = decode(pointer, reg, port) ? read_register(reg, port) : 0;
+		advance_pointer();
+	}
+}
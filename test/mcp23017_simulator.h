@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef MCP23017_SIMULATOR_H
+#define MCP23017_SIMULATOR_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "pico_pi_mocks.h"
+
+/**
+ * Works out the external input levels from the pins the device drives, see Mcp23017_simulator::set_input_model
+ * @param levels pin levels, output pins from OLAT
+ * @param outputs '1' bits are output pins
+ * @return input levels, '1' bits high
+ */
+typedef uint16_t (*mcp23017_simulator_input_model)(uint16_t levels, uint16_t outputs, void *context);
+
+/**
+ * Register level model of a MCP23017 that answers the mocked i2c calls for its address
+ *
+ * Models both IOCON.BANK layouts, sequential and byte (SEQOP) addressing, IPOL, OLAT vs GPIO,
+ * interrupt on change or compare with INTF/INTCAP and clear on read of GPIO or INTCAP, and mirrored INT pins.
+ */
+class Mcp23017_simulator {
+public:
+	/**
+	 * Create a device in its power on reset state and attach it to the mocked bus
+	 * @param i2c the bus it answers on
+	 * @param address the address it answers to
+	 */
+	Mcp23017_simulator(i2c_inst_t *i2c, uint8_t address);
+
+	~Mcp23017_simulator();
+
+	Mcp23017_simulator(const Mcp23017_simulator &) = delete;
+
+	Mcp23017_simulator &operator=(const Mcp23017_simulator &) = delete;
+
+	/**
+	 * Returns every register to its power on reset value
+	 */
+	void reset();
+
+	/**
+	 * Drives the external level of the pins, only input pins see it, interrupts are raised as the device would
+	 * @param levels '1' bits high
+	 */
+	void set_input_levels(uint16_t levels);
+
+	/**
+	 * Gets the level of the pins as seen outside the device, output pins from OLAT, input pins as driven
+	 */
+	[[nodiscard]] uint16_t get_pin_levels() const;
+
+	/**
+	 * Checks the INT output for a port, taking mirroring into account
+	 * @param port 0 for INTA, 1 for INTB
+	 * @return true if asserted
+	 */
+	[[nodiscard]] bool is_interrupt_asserted(int port) const;
+
+	/**
+	 * Gets a register by its BANK=0 address regardless of the current layout, without side effects
+	 * @param reg register address in the BANK=0 layout 0x00-0x15
+	 */
+	[[nodiscard]] uint8_t peek(uint8_t reg) const;
+
+	/**
+	 * Gets a 16 bit register pair by the BANK=0 address of port A, without side effects
+	 */
+	[[nodiscard]] uint16_t peek_pair(uint8_t reg) const;
+
+	/**
+	 * Records the 16 bit output latch after every byte written to OLAT or GPIO, to follow streamed waveforms
+	 * @param log appended to, nullptr to stop recording
+	 */
+	void set_output_log(std::vector<uint16_t> *log);
+
+	/**
+	 * Queues input levels, the next is driven after each read of GPIOB, to feed streamed reads a changing trace
+	 * @param levels '1' bits high, in order
+	 */
+	void set_input_sequence(const std::vector<uint16_t> &levels);
+
+	/**
+	 * Drives the inputs from the outputs whenever GPIO is read, to model circuits such as a switch matrix
+	 * @param model the model, nullptr to go back to the levels set
+	 * @param context passed to the model
+	 */
+	void set_input_model(mcp23017_simulator_input_model model, void *context);
+
+	[[nodiscard]] uint8_t get_address() const;
+
+	[[nodiscard]] i2c_inst_t *get_i2c() const;
+
+	/**
+	 * Bus side, called from the mocked i2c functions
+	 */
+	void write(const uint8_t *src, size_t len);
+
+	void read(uint8_t *dst, size_t len);
+
+private:
+	enum {
+		IODIR, IPOL, GPINTEN, DEFVAL, INTCON, IOCON, GPPU, INTF, INTCAP, GPIO, OLAT, REGISTERS
+	};
+
+	[[nodiscard]] bool decode(uint8_t pointer, int &reg, int &port) const;
+
+	void advance_pointer();
+
+	void write_register(int reg, int port, uint8_t value);
+
+	uint8_t read_register(int reg, int port);
+
+	[[nodiscard]] uint8_t port_value(int port) const;
+
+	void check_interrupts(int port, uint8_t previous);
+
+	i2c_inst_t *i2c;
+	uint8_t address;
+	uint8_t registers[REGISTERS][2]{};
+	uint8_t pointer{};
+	uint16_t input_levels{};
+	std::vector<uint16_t> *output_log{};
+	std::vector<uint16_t> input_sequence;
+	size_t next_input{};
+	mcp23017_simulator_input_model input_model{};
+	void *input_model_context{};
+};
+
+/**
+ * Finds the simulator attached for an address on a bus
+ * @return the simulator or nullptr if none, in which case the mocks play back mock_read_data
+ */
+Mcp23017_simulator *find_simulator(const i2c_inst_t *i2c, uint8_t address);
+
+#endif //MCP23017_SIMULATOR_H
@@ -4,11 +4,17 @@
  * SPDX-License-Identifier: Apache-2.0
  */
 
-#include <catch2/catch_test_macros.hpp>
+#include <deque>
 #include <vector>
 #include <cstring>
 
 #include "pico_pi_mocks.h"
+#include "mcp23017_simulator.h"
+#include "mcp23017_transaction.h"
+
+Mock_bus_stats mock_bus_stats{};
+uint32_t mock_bus_clock_hz = 100000;
+static bool bus_held = false; //last transfer was nostop so the next start is a repeated start
 
 int lastAddress;
 int last_length_read;
@@ -16,36 +22,319 @@ int last_length_written;
 long mock_data_read = 0;
 std::vector<uint8_t> mock_write_data;
 std::vector<uint8_t> mock_read_data;
+size_t mock_pending_transactions = 0;
+int mock_stop_count = 0;
+uint64_t mock_time_us = 0;
+uint64_t mock_last_timeout_us = 0;
+int mock_sda_stuck_clocks = 0;
+int mock_gpio_driven_high = 0;
+void (*mock_transfer_hook)() = nullptr;
+
+struct Mock_started_transaction {
+	Mcp23017_transaction_queue *queue;
+	Mcp23017_transaction *transaction;
+};
+
+static std::deque<Mock_started_transaction> started_transactions;
+static std::vector<repeating_timer_t *> running_timers;
+static std::deque<int> queued_i2c_results;
+
+struct Mock_gpio {
+	enum gpio_function function;
+	bool out;
+	bool value;
+	int rising_edges;
+};
+
+static Mock_gpio gpios[MOCK_GPIO_COUNT];
+static spin_lock_t spin_locks[MOCK_SPIN_LOCK_COUNT];
+static uint next_striped_lock = 0;
 
 void reset_for_test(const i2c_inst_t *i2c) {
 	lastAddress = 0;
 	last_length_read = 0;
 	last_length_written = 0;
 	mock_data_read = 0;
+	mock_stop_count = 0;
+	mock_time_us = 0;
 	mock_read_data.clear();
 	mock_write_data.clear();
+	started_transactions.clear();
+	mock_pending_transactions = 0;
+	mock_last_timeout_us = 0;
+	mock_sda_stuck_clocks = 0;
+	mock_gpio_driven_high = 0;
+	queued_i2c_results.clear();
+	mock_transfer_hook = nullptr;
+	for (auto &gpio : gpios) {
+		gpio = {GPIO_FUNC_NULL, false, false, 0};
+	}
+	reset_bus_stats();
+}
+
+void reset_bus_stats() {
+	mock_bus_stats = {};
+	bus_held = false;
+}
+
+double mock_bus_time_us(uint32_t clock_hz) {
+	if (clock_hz == 0) {
+		clock_hz = mock_bus_clock_hz;
+	}
+	return static_cast<double>(mock_bus_stats.bits) * 1000000.0 / clock_hz;
+}
+
+static void count_transfer(size_t len, bool nostop) {
+	mock_bus_stats.transactions++;
+	mock_bus_stats.bytes += len;
+	mock_bus_stats.starts++;
+	if (bus_held) {
+		mock_bus_stats.repeated_starts++;
+	}
+	mock_bus_stats.bits += 1 + 9 * (1 + len);
+	if (!nostop) {
+		mock_bus_stats.stops++;
+		mock_bus_stats.bits++;
+	}
+	bus_held = nostop;
 }
 
 void set_read_data(std::vector<uint8_t> &data, int length) {
 	mock_read_data = data;
 }
 
+void mock_queue_i2c_result(int result, int count) {
+	for (int i = 0; i < count; i++) {
+		queued_i2c_results.push_back(result);
+	}
+}
+
+static int take_queued_result(uint64_t timeout_us) {
+	if (queued_i2c_results.empty()) {
+		return PICO_ERROR_NONE;
+	}
+	int result = queued_i2c_results.front();
+	queued_i2c_results.pop_front();
+	if (result == PICO_ERROR_TIMEOUT) {
+		mock_time_us += timeout_us;
+	}
+	return result;
+}
+
+int i2c_read_timeout_us(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint timeout_us) {
+	mock_last_timeout_us = timeout_us;
+	int result = take_queued_result(timeout_us);
+	if (result != PICO_ERROR_NONE) {
+		lastAddress = addr;
+		bus_held = false;
+		return result;
+	}
+	return i2c_read_blocking(i2c, addr, dst, len, nostop);
+}
+
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop, uint timeout_us) {
+	mock_last_timeout_us = timeout_us;
+	int result = take_queued_result(timeout_us);
+	if (result != PICO_ERROR_NONE) {
+		lastAddress = addr;
+		bus_held = false;
+		return result;
+	}
+	return i2c_write_blocking(i2c, addr, src, len, nostop);
+}
+
+static void run_transfer_hook() {
+	void (*hook)() = mock_transfer_hook;
+	mock_transfer_hook = nullptr; //once, so that transfers made by the hook don't run it again
+	if (hook) {
+		hook();
+	}
+}
+
 int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop) {
+	run_transfer_hook();
 	lastAddress = addr;
-	for (int i = 0; i < len; i++) {
-		dst[i] = mock_read_data[mock_data_read];
-		mock_data_read++;
+	count_transfer(len, nostop);
+	Mcp23017_simulator *simulator = find_simulator(i2c, addr);
+	if (simulator) {
+		simulator->read(dst, len);
+	} else {
+		for (size_t i = 0; i < len; i++) {
+			dst[i] = mock_read_data[mock_data_read];
+			mock_data_read++;
+		}
 	}
 	last_length_read = len;
-	return PICO_ERROR_NONE;
+	if (!nostop) {
+		mock_stop_count++;
+	}
+	return static_cast<int>(len);
 }
 
 int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop) {
+	run_transfer_hook();
 	lastAddress = addr;
-	for (int i = 0; i < len; i++) {
+	count_transfer(len, nostop);
+	for (size_t i = 0; i < len; i++) {
 		mock_write_data.push_back(src[i]);
 	}
+	Mcp23017_simulator *simulator = find_simulator(i2c, addr);
+	if (simulator) {
+		simulator->write(src, len);
+	}
 	last_length_written = len;
-	return PICO_ERROR_NONE;
+	if (!nostop) {
+		mock_stop_count++;
+	}
+	return static_cast<int>(len);
 }
 
+
+uint64_t time_us_64() {
+	return mock_time_us;
+}
+
+uint32_t time_us_32() {
+	return static_cast<uint32_t>(mock_time_us);
+}
+
+void sleep_us(uint64_t us) {
+	mock_time_us += us;
+}
+
+void busy_wait_us(uint64_t us) {
+	mock_time_us += us;
+}
+
+static void mock_gpio_drive(uint gpio, bool out, bool value) {
+	Mock_gpio &pin = gpios[gpio];
+	bool was_high = !pin.out || pin.value;
+	if (out && value) {
+		mock_gpio_driven_high++;
+	}
+	if (!was_high && (!out || value)) {
+		pin.rising_edges++;
+		if (mock_sda_stuck_clocks > 0) {
+			mock_sda_stuck_clocks--; //only SCL moves while a slave holds SDA
+		}
+	}
+	pin.out = out;
+	pin.value = value;
+}
+
+void gpio_init(uint gpio) {
+	mock_gpio_drive(gpio, false, false);
+	gpios[gpio].function = GPIO_FUNC_SIO;
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+	mock_gpio_drive(gpio, out, gpios[gpio].value);
+}
+
+void gpio_put(uint gpio, bool value) {
+	mock_gpio_drive(gpio, gpios[gpio].out, value);
+}
+
+bool gpio_get(uint gpio) {
+	if (gpios[gpio].out) {
+		return gpios[gpio].value;
+	}
+	return mock_sda_stuck_clocks == 0; //only SDA is read, pulled up unless a slave holds it
+}
+
+void gpio_pull_up(uint) {
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn) {
+	gpios[gpio].function = fn;
+}
+
+enum gpio_function mock_gpio_get_function(uint gpio) {
+	return gpios[gpio].function;
+}
+
+int mock_gpio_rising_edges(uint gpio) {
+	return gpios[gpio].rising_edges;
+}
+
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void *user_data, repeating_timer_t *out) {
+	out->delay_us = delay_us;
+	out->callback = callback;
+	out->user_data = user_data;
+	running_timers.push_back(out);
+	return true;
+}
+
+bool cancel_repeating_timer(repeating_timer_t *timer) {
+	for (auto it = running_timers.begin(); it != running_timers.end(); it++) {
+		if (*it == timer) {
+			running_timers.erase(it);
+			return true;
+		}
+	}
+	return false;
+}
+
+int mock_run_timers() {
+	std::vector<repeating_timer_t *> timers = running_timers;
+	for (auto timer : timers) {
+		if (!timer->callback(timer)) {
+			cancel_repeating_timer(timer);
+		}
+	}
+	return static_cast<int>(timers.size());
+}
+
+uint32_t save_and_disable_interrupts() {
+	return 0;
+}
+
+void restore_interrupts(uint32_t) {
+}
+
+spin_lock_t *spin_lock_instance(uint lock_num) {
+	return &spin_locks[lock_num % MOCK_SPIN_LOCK_COUNT];
+}
+
+uint next_striped_spin_lock_num() {
+	return 16 + (next_striped_lock++ % 8); //the sdk's striped locks are 16-23
+}
+
+uint32_t spin_lock_blocking(spin_lock_t *lock) {
+	while (lock->exchange(1, std::memory_order_acquire) != 0) {
+	}
+	return 0;
+}
+
+void spin_unlock(spin_lock_t *lock, uint32_t) {
+	lock->store(0, std::memory_order_release);
+}
+
+void mcp23017_port_start(Mcp23017_transaction_queue &queue, Mcp23017_transaction &transaction) {
+	started_transactions.push_back({&queue, &transaction});
+	mock_pending_transactions = started_transactions.size();
+}
+
+bool mock_complete_transaction(int result) {
+	if (started_transactions.empty()) {
+		return false;
+	}
+	Mock_started_transaction started = started_transactions.front();
+	started_transactions.pop_front();
+	mock_pending_transactions = started_transactions.size();
+
+	Mcp23017_transaction &transaction = *started.transaction;
+	if (transaction.read) {
+		i2c_write_blocking(started.queue->get_i2c(), transaction.address, &transaction.reg, 1, true);
+		if (result == PICO_ERROR_NONE) {
+			i2c_read_blocking(started.queue->get_i2c(), transaction.address, transaction.data, transaction.length, false);
+		}
+	} else {
+		uint8_t command[1 + MCP23017_TRANSACTION_MAX_DATA];
+		command[0] = transaction.reg;
+		memcpy(&command[1], transaction.data, transaction.length);
+		i2c_write_blocking(started.queue->get_i2c(), transaction.address, command, 1 + transaction.length, false);
+	}
+	started.queue->transaction_finished(result);
+	return true;
+}
@@ -7,6 +7,8 @@
 #ifndef PICO_PI_MOCKS_H
 #define PICO_PI_MOCKS_H
 
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <vector>
 
@@ -22,6 +24,31 @@ typedef struct i2c_inst i2c_inst_t;
 
 typedef	unsigned int uint;
 
+struct repeating_timer;
+
+typedef bool (*repeating_timer_callback_t)(struct repeating_timer *rt);
+
+typedef struct repeating_timer {
+	int64_t delay_us;
+	repeating_timer_callback_t callback;
+	void *user_data;
+} repeating_timer_t;
+
+typedef std::atomic<uint32_t> spin_lock_t;
+
+#define MOCK_SPIN_LOCK_COUNT 32
+
+#define GPIO_OUT 1
+#define GPIO_IN 0
+
+enum gpio_function {
+	GPIO_FUNC_I2C = 3,
+	GPIO_FUNC_SIO = 5,
+	GPIO_FUNC_NULL = 0x1f,
+};
+
+#define MOCK_GPIO_COUNT 30
+
 enum {
 	PICO_OK = 0,
 	PICO_ERROR_NONE = 0,
@@ -30,6 +57,21 @@ enum {
 	PICO_ERROR_NO_DATA = -3,
 };
 
+/**
+ * Modelled bus activity of the mocked i2c calls
+ */
+struct Mock_bus_stats {
+	uint32_t transactions; //addressed transfers, one per i2c call
+	uint32_t bytes; //data bytes, excluding the address byte
+	uint32_t starts; //start conditions, including repeated starts
+	uint32_t repeated_starts;
+	uint32_t stops;
+	uint64_t bits; //bit times on SCL, 9 per byte including the address, 1 per start or stop
+};
+
+extern Mock_bus_stats mock_bus_stats;
+extern uint32_t mock_bus_clock_hz;
+
 extern int lastAddress;
 extern int last_length_read;
 extern int last_length_written;
@@ -37,12 +79,99 @@ extern long mock_data_read;
 extern std::vector<uint8_t> mock_write_data;
 extern std::vector<uint8_t> mock_read_data;
 
+extern uint64_t mock_last_timeout_us;
+extern int mock_sda_stuck_clocks; //SCL clocks before SDA is released, -1 held low for ever
+extern int mock_gpio_driven_high; //times a gpio was driven high as an output, never allowed on the open drain bus
+
+extern void (*mock_transfer_hook)(); //called at the start of each transfer that reaches the bus, as if from another core
+
+extern size_t mock_pending_transactions;
+extern uint64_t mock_time_us;
+extern int mock_stop_count;
+
 void reset_for_test(const i2c_inst_t *i2c);
 
+/**
+ * Clears mock_bus_stats
+ */
+void reset_bus_stats();
+
+/**
+ * Modelled time for the bits counted so far
+ * @param clock_hz the bus clock, 0 for mock_bus_clock_hz
+ * @return time in microseconds
+ */
+double mock_bus_time_us(uint32_t clock_hz);
+
+/**
+ * Completes the oldest transaction started through the port layer against the mock read/write data
+ * @param result the result to report, PICO_ERROR_NONE or an error to simulate a failure
+ * @return false if there was no transaction in progress
+ */
+bool mock_complete_transaction(int result);
+
+uint64_t time_us_64();
+
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void *user_data, repeating_timer_t *out);
+
+bool cancel_repeating_timer(repeating_timer_t *timer);
+
+/**
+ * Calls every running repeating timer callback once, as if their period had elapsed
+ * @return number of timers run
+ */
+int mock_run_timers();
+
+uint32_t time_us_32();
+
+uint32_t save_and_disable_interrupts();
+
+void restore_interrupts(uint32_t status);
+
+spin_lock_t *spin_lock_instance(uint lock_num);
+
+uint next_striped_spin_lock_num();
+
+uint32_t spin_lock_blocking(spin_lock_t *lock);
+
+void spin_unlock(spin_lock_t *lock, uint32_t saved_irq);
+
+/**
+ * Makes upcoming i2c calls fail, each call takes the next queued result
+ * A PICO_ERROR_TIMEOUT also advances mock_time_us by the timeout of the call
+ * @param result the error to return, PICO_ERROR_NONE lets the call through
+ * @param count number of calls to apply it to
+ */
+void mock_queue_i2c_result(int result, int count);
+
+void sleep_us(uint64_t us);
+
+void busy_wait_us(uint64_t us);
+
+void gpio_init(uint gpio);
+
+void gpio_set_dir(uint gpio, bool out);
+
+void gpio_put(uint gpio, bool value);
+
+bool gpio_get(uint gpio);
+
+void gpio_pull_up(uint gpio);
+
+void gpio_set_function(uint gpio, enum gpio_function fn);
+
+enum gpio_function mock_gpio_get_function(uint gpio);
+
+int mock_gpio_rising_edges(uint gpio); //low to high transitions of the line, pulled up when not driven
+
 void set_read_data(std::vector<uint8_t> &data, int length);
 
 int i2c_read_blocking(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop);
 
 int i2c_write_blocking(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop);
 
+int i2c_read_timeout_us(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint timeout_us);
+
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop, uint timeout_us);
+
 #endif // PICO_PI_MOCKS_H
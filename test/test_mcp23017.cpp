@@ -10,6 +10,7 @@
 
 #include "mcp23017.h"
 #include "mcp23017_private.h"
+#include "mcp23017_transaction.h"
 
 static const int MCP_ALL_PINS_INPUT = 0xffff;
 static const int MCP_ALL_PINS_OUTPUT = 0x0000;
@@ -112,30 +113,30 @@ TEST_CASE("Get Input Pin Values GPIOA", "[mcp23017]") {
 	reset_for_test(i2c0);
 	std::vector<uint8_t> data = {0b00000010, 0b00000000};
 	set_read_data(data, 1);
-	auto ret = mcp.update_input_values();
+	auto ret = mcp.update_and_get_input_values();
 	REQUIRE(ret == PICO_ERROR_NONE);
 	REQUIRE(lastAddress == 0x20);
 	REQUIRE(mock_data_read ==  2);
 	REQUIRE(last_length_written == 1);
 	REQUIRE(mock_write_data.size() == 1);
 	REQUIRE(mock_write_data[0] == MCP23017_GPIOA);
-	REQUIRE(mcp.get_input_pin_value(1) == true);
-	REQUIRE(mcp.get_input_pin_value(0) == false);
+	REQUIRE(mcp.get_last_input_pin_value(1) == true);
+	REQUIRE(mcp.get_last_input_pin_value(0) == false);
 }
 
 TEST_CASE("Get Input Pin Values GPIOB", "[mcp23017]") {
 	reset_for_test(i2c0);
 	std::vector<uint8_t> data = {0b00000000, 0b0001000};
 	set_read_data(data, 1);
-	auto ret = mcp.update_input_values();
+	auto ret = mcp.update_and_get_input_values();
 	REQUIRE(ret == PICO_ERROR_NONE);
 	REQUIRE(lastAddress == 0x20);
 	REQUIRE(mock_data_read ==  2);
 	REQUIRE(last_length_written == 1);
 	REQUIRE(mock_write_data.size() == 1);
 	REQUIRE(mock_write_data[0] == MCP23017_GPIOA);
-	REQUIRE(mcp.get_input_pin_value(11) == true);
-	REQUIRE(mcp.get_input_pin_value(0) == false);
+	REQUIRE(mcp.get_last_input_pin_value(11) == true);
+	REQUIRE(mcp.get_last_input_pin_value(0) == false);
 }
 
 TEST_CASE("Set Output Pin Values", "[mcp23017]") {
@@ -146,25 +147,60 @@ TEST_CASE("Set Output Pin Values", "[mcp23017]") {
 	REQUIRE(mock_data_read ==  0);
 	REQUIRE(last_length_written == 3);
 	REQUIRE(mock_write_data.size() == 3);
-	REQUIRE(mock_write_data[0] == MCP23017_GPIOA);
+	REQUIRE(mock_write_data[0] == MCP23017_OLATA);
 	REQUIRE(mock_write_data[1] == 0xaa);
 	REQUIRE(mock_write_data[2] == 0xaa);
 }
 
 TEST_CASE("Set Output Pin 5", "[mcp23017]") {
 	reset_for_test(i2c0);
-	mcp.set_output_bit_for_pin(5, true);
-	auto ret = mcp.flush_output();
+	Mcp23017 mcp_out(i2c0, 0x20);
+	mcp_out.set_output_bit_for_pin(5, true);
+	auto ret = mcp_out.flush_output();
 	REQUIRE(ret == PICO_ERROR_NONE);
 	REQUIRE(lastAddress == 0x20);
 	REQUIRE(mock_data_read ==  0);
 	REQUIRE(last_length_written == 3);
 	REQUIRE(mock_write_data.size() == 3);
-	REQUIRE(mock_write_data[0] == MCP23017_GPIOA);
+	REQUIRE(mock_write_data[0] == MCP23017_OLATA);
 	REQUIRE(mock_write_data[1] == 0b100000);
 	REQUIRE(mock_write_data[2] == 0);
 }
 
+TEST_CASE("Flush Only Changed Output Ports", "[mcp23017]") {
+	reset_for_test(i2c0);
+	Mcp23017 mcp_out(i2c0, 0x20);
+	REQUIRE(mcp_out.set_all_output_bits(0x0000) == PICO_ERROR_NONE);
+	REQUIRE(mock_write_data.size() == 3);
+
+	reset_for_test(i2c0);
+	mcp_out.set_output_bit_for_pin(3, true);
+	REQUIRE(mcp_out.flush_output() == PICO_ERROR_NONE);
+	REQUIRE(last_length_written == 2);
+	REQUIRE(mock_write_data[0] == MCP23017_OLATA);
+	REQUIRE(mock_write_data[1] == 0b1000);
+
+	reset_for_test(i2c0);
+	mcp_out.set_output_bit_for_pin(9, true);
+	REQUIRE(mcp_out.flush_output() == PICO_ERROR_NONE);
+	REQUIRE(last_length_written == 2);
+	REQUIRE(mock_write_data[0] == MCP23017_OLATB);
+	REQUIRE(mock_write_data[1] == 0b10);
+
+	reset_for_test(i2c0);
+	mcp_out.set_output_bit_for_pin(0, true);
+	mcp_out.set_output_bit_for_pin(15, true);
+	REQUIRE(mcp_out.flush_output() == PICO_ERROR_NONE);
+	REQUIRE(last_length_written == 3);
+	REQUIRE(mock_write_data[0] == MCP23017_OLATA);
+	REQUIRE(mock_write_data[1] == 0b1001);
+	REQUIRE(mock_write_data[2] == 0b10000010);
+
+	reset_for_test(i2c0);
+	REQUIRE(mcp_out.flush_output() == PICO_ERROR_NONE);
+	REQUIRE(mock_write_data.empty());
+}
+
 TEST_CASE("Setup", "[mcp23017]") {
 	reset_for_test(i2c0);
 
@@ -174,11 +210,61 @@ TEST_CASE("Setup", "[mcp23017]") {
 	REQUIRE(last_length_read ==  0);
 	REQUIRE(last_length_written ==  2);
 	REQUIRE(mock_data_read ==  0);
-	REQUIRE(mock_write_data.size() ==  4);
+	REQUIRE(mock_write_data.size() ==  2); //IOCONB is the same register as IOCONA with BANK=0 so is skipped
 	REQUIRE((int)mock_write_data[0] == MCP23017_IOCONA); //Write
 	REQUIRE((int)mock_write_data[1] == 64); //Value written MCP23017_IOCON_MIRROR_BIT
-	REQUIRE((int)mock_write_data[2] == MCP23017_IOCONB); //Write
-	REQUIRE((int)mock_write_data[3] == 64); //Value written MCP23017_IOCON_MIRROR_BIT
+	REQUIRE(mcp.is_register_valid(MCP23017_IOCONB));
+}
+
+TEST_CASE("Skip Redundant Writes", "[mcp23017]") {
+	reset_for_test(i2c0);
+	Mcp23017 mcp_cached(i2c0, 0x20);
+
+	REQUIRE(mcp_cached.set_pullup(MCP_ALL_PINS_PULL_UP) == PICO_ERROR_NONE);
+	REQUIRE(mcp_cached.set_pullup(MCP_ALL_PINS_PULL_UP) == PICO_ERROR_NONE);
+	REQUIRE(mock_write_data.size() == 3);
+	REQUIRE(mcp_cached.is_register_valid(MCP23017_GPPUA));
+	REQUIRE(mcp_cached.is_register_valid(MCP23017_GPPUB));
+	REQUIRE(!mcp_cached.is_register_dirty(MCP23017_GPPUA));
+
+	REQUIRE(mcp_cached.set_all_output_bits(MCP_ALTERNATE_PINS_ON) == PICO_ERROR_NONE);
+	mcp_cached.set_output_bit_for_pin(1, true);
+	REQUIRE(mcp_cached.flush_output() == PICO_ERROR_NONE);
+	REQUIRE(mock_write_data.size() == 6);
+
+	REQUIRE(mcp_cached.set_pullup(0x00ff) == PICO_ERROR_NONE);
+	REQUIRE(mock_write_data.size() == 9);
+	REQUIRE(mock_write_data[6] == MCP23017_GPPUA);
+	REQUIRE(mock_write_data[7] == 0xff);
+	REQUIRE(mock_write_data[8] == 0x00);
+}
+
+TEST_CASE("Invalidate And Resync Registers", "[mcp23017]") {
+	reset_for_test(i2c0);
+	Mcp23017 mcp_reset(i2c0, 0x20);
+	mcp_reset.set_io_direction(MCP_ALL_PINS_INPUT);
+	mcp_reset.set_pullup(MCP_ALL_PINS_PULL_UP);
+	mcp_reset.set_all_output_bits(MCP_ALTERNATE_PINS_ON);
+
+	mcp_reset.invalidate_registers();
+	REQUIRE(!mcp_reset.is_register_valid(MCP23017_IODIRA));
+	REQUIRE(mcp_reset.is_register_dirty(MCP23017_IODIRA));
+
+	reset_for_test(i2c0);
+	REQUIRE(mcp_reset.resync_registers() == PICO_ERROR_NONE);
+	REQUIRE(mock_write_data.size() == 9);
+	REQUIRE(mock_write_data[0] == MCP23017_IODIRA);
+	REQUIRE(mock_write_data[1] == 0xff);
+	REQUIRE(mock_write_data[2] == 0xff);
+	REQUIRE(mock_write_data[3] == MCP23017_GPPUA);
+	REQUIRE(mock_write_data[6] == MCP23017_OLATA);
+	REQUIRE(mock_write_data[7] == 0xaa);
+	REQUIRE(mcp_reset.is_register_valid(MCP23017_GPPUB));
+	REQUIRE(!mcp_reset.is_register_dirty(MCP23017_GPPUB));
+
+	reset_for_test(i2c0);
+	REQUIRE(mcp_reset.set_io_direction(MCP_ALL_PINS_INPUT) == PICO_ERROR_NONE);
+	REQUIRE(mock_write_data.empty());
 }
 
 TEST_CASE("Get Last Interrupt Pin None", "[mcp23017]") {
@@ -247,3 +333,155 @@ TEST_CASE("Get Last Interrupt Pin 8(B-0) Value 1", "[mcp23017]") {
 	REQUIRE(mock_write_data[0] == MCP23017_INTFA); //Read
 	REQUIRE(mock_write_data[1] == MCP23017_INTCAPA); //Read
 }
+
+TEST_CASE("Service Interrupt", "[mcp23017]") {
+	reset_for_test(i2c0);
+	std::vector<uint8_t> data = {0b00000000, 0b00000001, 0b00000000, 0b00000001, 0b00000010, 0b00000000};
+	set_read_data(data, 6);
+
+	Mcp23017_interrupt_state state{};
+	int ret = mcp.service_interrupt(state);
+
+	REQUIRE(ret == PICO_ERROR_NONE);
+	REQUIRE(state.flags == 0x0100);
+	REQUIRE(state.captured == 0x0100);
+	REQUIRE(state.inputs == 0x0002);
+	REQUIRE(mcp.get_last_input_pin_values() == 0x0002);
+	REQUIRE(lastAddress ==  0x20);
+	REQUIRE(mock_data_read ==  6);
+	REQUIRE(last_length_read ==  6);
+	REQUIRE(last_length_written ==  1);
+	REQUIRE(mock_write_data.size() ==  1);
+	REQUIRE(mock_write_data[0] == MCP23017_INTFA); //Read
+}
+
+static void count_completed(Mcp23017_transaction &, void *context) {
+	(*static_cast<int *>(context))++;
+}
+
+TEST_CASE("Async Transactions Complete In Order", "[mcp23017]") {
+	reset_for_test(i2c0);
+	Mcp23017_transaction_queue queue(i2c0);
+	Mcp23017 mcp_async(i2c0, 0x20);
+	mcp_async.set_transaction_queue(&queue);
+	Mcp23017_transaction input_transaction;
+	Mcp23017_transaction output_transaction;
+	int completed = 0;
+
+	std::vector<uint8_t> data = {0b00000100, 0b10000000};
+	set_read_data(data, 2);
+	mcp_async.set_output_bit_for_pin(8, true);
+	REQUIRE(mcp_async.update_input_values_async(input_transaction, count_completed, &completed) == PICO_ERROR_NONE);
+	REQUIRE(mcp_async.flush_output_async(output_transaction, count_completed, &completed) == PICO_ERROR_NONE);
+	REQUIRE(mcp_async.update_input_values_async(input_transaction, count_completed, &completed) == PICO_ERROR_GENERIC);
+	REQUIRE(mock_pending_transactions == 1);
+	REQUIRE(mock_write_data.empty());
+	REQUIRE(!queue.is_idle());
+
+	REQUIRE(mock_complete_transaction(PICO_ERROR_NONE));
+	REQUIRE(completed == 1);
+	REQUIRE(!input_transaction.busy);
+	REQUIRE(mcp_async.get_last_input_pin_values() == 0x8004);
+	REQUIRE(mock_pending_transactions == 1);
+	REQUIRE(output_transaction.busy);
+
+	REQUIRE(mock_complete_transaction(PICO_ERROR_NONE));
+	REQUIRE(completed == 2);
+	REQUIRE(queue.is_idle());
+	REQUIRE(mock_write_data.size() == 4);
+	REQUIRE(mock_write_data[0] == MCP23017_GPIOA);
+	REQUIRE(mock_write_data[1] == MCP23017_OLATA);
+	REQUIRE(mock_write_data[2] == 0x00);
+	REQUIRE(mock_write_data[3] == 0x01);
+	REQUIRE(mcp_async.is_register_valid(MCP23017_OLATB));
+
+	reset_for_test(i2c0);
+	REQUIRE(mcp_async.flush_output() == PICO_ERROR_NONE);
+	REQUIRE(mock_write_data.empty());
+	REQUIRE(!mock_complete_transaction(PICO_ERROR_NONE));
+}
+
+TEST_CASE("Async Transaction Failure", "[mcp23017]") {
+	reset_for_test(i2c0);
+	Mcp23017_transaction_queue queue(i2c0);
+	Mcp23017 mcp_async(i2c0, 0x20);
+	Mcp23017_transaction transaction;
+	uint8_t values[] = {0xff, 0xff};
+
+	REQUIRE(mcp_async.write_registers_async(transaction, MCP23017_GPPUA, values, 2, nullptr, nullptr) == PICO_ERROR_GENERIC);
+	mcp_async.set_transaction_queue(&queue);
+	REQUIRE(mcp_async.write_registers_async(transaction, MCP23017_GPPUA, values, 2, nullptr, nullptr) == PICO_ERROR_NONE);
+	REQUIRE(mcp_async.is_register_dirty(MCP23017_GPPUA));
+
+	REQUIRE(mock_complete_transaction(PICO_ERROR_GENERIC));
+	REQUIRE(transaction.result == PICO_ERROR_GENERIC);
+	REQUIRE(!mcp_async.is_register_valid(MCP23017_GPPUA));
+	REQUIRE(mcp_async.is_register_dirty(MCP23017_GPPUA));
+}
+
+TEST_CASE("Apply Config In One Burst", "[mcp23017]") {
+	reset_for_test(i2c0);
+	Mcp23017 mcp_config(i2c0, 0x20);
+	Mcp23017_config config;
+	config.io_direction = MCP_ALL_PINS_INPUT;
+	config.pullup = MCP_ALL_PINS_PULL_UP;
+	config.interrupt_control = MCP_ALL_PINS_COMPARE_TO_LAST;
+	config.interrupt_enable = MCP_ALL_PINS_INTERRUPT_ENABLED;
+	config.mirroring = true;
+
+	REQUIRE(mcp_config.apply(config) == PICO_ERROR_NONE);
+	REQUIRE(mock_stop_count == 1);
+	REQUIRE(mock_write_data.size() == 1 + MCP23017_CONFIG_REGISTER_COUNT);
+	REQUIRE(mock_write_data[0] == MCP23017_IODIRA);
+	REQUIRE(mock_write_data[1 + MCP23017_IODIRB] == 0xff);
+	REQUIRE(mock_write_data[1 + MCP23017_GPINTENA] == 0xff);
+	REQUIRE(mock_write_data[1 + MCP23017_IOCONA] == 64);
+	REQUIRE(mock_write_data[1 + MCP23017_IOCONB] == 64);
+	REQUIRE(mock_write_data[1 + MCP23017_GPPUB] == 0xff);
+
+	reset_for_test(i2c0);
+	REQUIRE(mcp_config.apply(config) == PICO_ERROR_NONE);
+	REQUIRE(mock_write_data.empty());
+	REQUIRE(mcp_config.set_pullup(MCP_ALL_PINS_PULL_UP) == PICO_ERROR_NONE);
+	REQUIRE(mock_write_data.empty());
+
+	config.input_polarity = 0x0100;
+	config.default_value = 0x0001;
+	REQUIRE(mcp_config.apply(config) == PICO_ERROR_NONE);
+	REQUIRE(mock_write_data.size() == 1 + 4); //IPOLB to DEFVALA
+	REQUIRE(mock_write_data[0] == MCP23017_IPOLB);
+	REQUIRE(mock_write_data[1] == 0x01);
+	REQUIRE(mock_write_data[4] == 0x01);
+}
+
+TEST_CASE("Apply Config Without Sequential Operation", "[mcp23017]") {
+	reset_for_test(i2c0);
+	Mcp23017 mcp_config(i2c0, 0x20);
+	Mcp23017_config config;
+	config.sequential = false;
+
+	REQUIRE(mcp_config.apply(config) == PICO_ERROR_NONE);
+	REQUIRE(mock_stop_count == 2);
+	REQUIRE(mock_write_data[1 + MCP23017_IOCONA] == 0);
+	REQUIRE(mock_write_data[15] == MCP23017_IOCONA);
+	REQUIRE(mock_write_data[16] == 1 << MCP23017_IOCON_SEQOP_BIT);
+
+	reset_for_test(i2c0);
+	REQUIRE(mcp_config.apply(config) == PICO_ERROR_NONE);
+	REQUIRE(mock_write_data.empty());
+
+	REQUIRE(mcp_config.setup(true, false) == PICO_ERROR_NONE);
+	REQUIRE(mock_write_data.size() == 2);
+	REQUIRE(mock_write_data[1] == ((1 << MCP23017_IOCON_MIRROR_BIT) | (1 << MCP23017_IOCON_SEQOP_BIT)));
+
+	reset_for_test(i2c0);
+	config.sequential = true;
+	config.pullup = MCP_ALL_PINS_PULL_UP;
+	REQUIRE(mcp_config.apply(config) == PICO_ERROR_NONE);
+	REQUIRE(mock_stop_count == 2);
+	REQUIRE(mock_write_data[0] == MCP23017_IOCONA);
+	REQUIRE(mock_write_data[2] == MCP23017_IOCONA);
+	REQUIRE(mock_write_data[3] == 0);
+	REQUIRE(mock_write_data[4] == 0);
+	REQUIRE(mock_write_data[5] == 0xff);
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+
+#include "mcp23017.h"
+#include "mcp23017_bus.h"
+#include "mcp23017_private.h"
+
+static i2c_inst_t bus_i2c{};
+static i2c_inst_t other_i2c{};
+
+TEST_CASE("Bus Add Devices", "[mcp23017_bus]") {
+	Mcp23017_bus bus(&bus_i2c);
+	Mcp23017 mcp0(&bus_i2c, 0x20);
+	Mcp23017 mcp1(&bus_i2c, 0x21);
+	Mcp23017 duplicate(&bus_i2c, 0x20);
+	Mcp23017 elsewhere(&other_i2c, 0x22);
+
+	REQUIRE(bus.add_device(mcp0) == 0);
+	REQUIRE(bus.add_device(mcp1) == 1);
+	REQUIRE(bus.add_device(duplicate) == PICO_ERROR_GENERIC);
+	REQUIRE(bus.add_device(elsewhere) == PICO_ERROR_GENERIC);
+	REQUIRE(bus.get_device_count() == 2);
+	REQUIRE(bus.get_device(1) == &mcp1);
+	REQUIRE(bus.get_device(2) == nullptr);
+}
+
+TEST_CASE("Bus Poll All", "[mcp23017_bus]") {
+	reset_for_test(&bus_i2c);
+	Mcp23017_bus bus(&bus_i2c);
+	Mcp23017 mcp0(&bus_i2c, 0x20);
+	Mcp23017 mcp1(&bus_i2c, 0x21);
+	Mcp23017 mcp7(&bus_i2c, 0x27);
+	bus.add_device(mcp0);
+	bus.add_device(mcp1);
+	bus.add_device(mcp7);
+	std::vector<uint8_t> data = {0x01, 0x80, 0x02, 0x40, 0x03, 0x20};
+	set_read_data(data, 6);
+
+	REQUIRE(bus.poll_all() == PICO_ERROR_NONE);
+
+	REQUIRE(mock_data_read == 6);
+	REQUIRE(mock_stop_count == 1);
+	REQUIRE(lastAddress == 0x27);
+	REQUIRE(mock_write_data.size() == 3);
+	REQUIRE(mock_write_data[0] == MCP23017_GPIOA);
+	REQUIRE(mock_write_data[2] == MCP23017_GPIOA);
+	const uint16_t *snapshot = bus.get_snapshot();
+	REQUIRE(snapshot[0] == 0x8001);
+	REQUIRE(snapshot[1] == 0x4002);
+	REQUIRE(snapshot[2] == 0x2003);
+	REQUIRE(mcp1.get_last_input_pin_values() == 0x4002);
+}
+
+TEST_CASE("Bus Flush All", "[mcp23017_bus]") {
+	reset_for_test(&bus_i2c);
+	Mcp23017_bus bus(&bus_i2c);
+	Mcp23017 mcp0(&bus_i2c, 0x20);
+	Mcp23017 mcp1(&bus_i2c, 0x21);
+	bus.add_device(mcp0);
+	bus.add_device(mcp1);
+	mcp0.set_all_output_bits(0x0000);
+	mcp1.set_all_output_bits(0x0000);
+
+	reset_for_test(&bus_i2c);
+	mcp1.set_output_bit_for_pin(2, true);
+	REQUIRE(bus.flush_all() == PICO_ERROR_NONE);
+
+	REQUIRE(lastAddress == 0x21);
+	REQUIRE(mock_write_data.size() == 2);
+	REQUIRE(mock_write_data[0] == MCP23017_OLATA);
+	REQUIRE(mock_write_data[1] == 0b100);
+
+	mcp0.set_output_bit_for_pin(0, true);
+	mock_queue_i2c_result(PICO_ERROR_TIMEOUT, 1);
+	REQUIRE(bus.flush_all() == MCP23017_ERROR_TIMEOUT);
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+
+#include "mcp23017.h"
+#include "mcp23017_capture.h"
+#include "mcp23017_private.h"
+#include "mcp23017_simulator.h"
+
+static i2c_inst_t capture_i2c{};
+
+static void bus_takes_640us() {
+	mock_time_us += 640;
+}
+
+TEST_CASE("Capture Samples In Order", "[mcp23017_capture]") {
+	reset_for_test(&capture_i2c);
+	Mcp23017_simulator chip(&capture_i2c, 0x20);
+	Mcp23017 mcp_capture(&capture_i2c, 0x20);
+	Mcp23017_ring<Mcp23017_capture_sample, 64> samples;
+	Mcp23017_capture<64> capture(mcp_capture, samples);
+	std::vector<uint16_t> levels;
+	for (int i = 0; i < 40; i++) {
+		levels.push_back(static_cast<uint16_t>(0x8001 * i));
+	}
+	chip.set_input_levels(levels[0]);
+	chip.set_input_sequence(std::vector<uint16_t>(levels.begin() + 1, levels.end()));
+
+	reset_bus_stats();
+	REQUIRE(capture.capture(levels.size()) == PICO_ERROR_NONE);
+
+	REQUIRE(samples.size() == levels.size());
+	for (uint16_t level : levels) {
+		Mcp23017_capture_sample sample{};
+		REQUIRE(samples.pop(sample));
+		REQUIRE(sample.inputs == level);
+		REQUIRE(sample.count == 1);
+	}
+	REQUIRE(capture.get_sample_count() == levels.size());
+	REQUIRE(mcp_capture.get_last_input_pin_values() == levels.back());
+
+	//IOCON either side, the pointer once, then 2 chunks joined by repeated starts
+	REQUIRE(mock_bus_stats.transactions == 2 + 1 + 2);
+	REQUIRE(mock_bus_stats.repeated_starts == 2);
+	REQUIRE(mock_bus_stats.bytes == 2 * 2 + 1 + 2 * levels.size());
+	REQUIRE((chip.peek(MCP23017_IOCONA) & (1 << MCP23017_IOCON_SEQOP_BIT)) == 0);
+}
+
+TEST_CASE("Capture Timestamps Spread Across The Chunk", "[mcp23017_capture]") {
+	reset_for_test(&capture_i2c);
+	Mcp23017_simulator chip(&capture_i2c, 0x20);
+	Mcp23017 mcp_capture(&capture_i2c, 0x20);
+	Mcp23017_config config;
+	config.sequential = false;
+	REQUIRE(mcp_capture.apply(config) == PICO_ERROR_NONE);
+	Mcp23017_ring<Mcp23017_capture_sample, 64> samples;
+	Mcp23017_capture<64> capture(mcp_capture, samples);
+	mock_time_us = 1000;
+
+	mock_transfer_hook = bus_takes_640us;
+	REQUIRE(capture.capture(MCP23017_STREAM_CHUNK_WORDS) == PICO_ERROR_NONE);
+
+	uint64_t per_sample_us = 640 / MCP23017_STREAM_CHUNK_WORDS;
+	for (uint64_t i = 1; i <= MCP23017_STREAM_CHUNK_WORDS; i++) {
+		Mcp23017_capture_sample sample{};
+		REQUIRE(samples.pop(sample));
+		REQUIRE(sample.timestamp_us == 1000 + i * per_sample_us);
+	}
+}
+
+TEST_CASE("Capture Run Length Compressed", "[mcp23017_capture]") {
+	reset_for_test(&capture_i2c);
+	Mcp23017_simulator chip(&capture_i2c, 0x20);
+	Mcp23017 mcp_capture(&capture_i2c, 0x20);
+	Mcp23017_ring<Mcp23017_capture_sample, 64> samples;
+	Mcp23017_capture<64> capture(mcp_capture, samples, true);
+	chip.set_input_levels(0x0000);
+	chip.set_input_sequence({0x0000, 0x0000, 0x0100, 0x0100, 0x0000});
+
+	REQUIRE(capture.capture(6) == PICO_ERROR_NONE);
+
+	Mcp23017_capture_sample sample{};
+	REQUIRE(samples.size() == 3);
+	REQUIRE(samples.pop(sample));
+	REQUIRE(sample.inputs == 0x0000);
+	REQUIRE(sample.count == 3);
+	REQUIRE(samples.pop(sample));
+	REQUIRE(sample.inputs == 0x0100);
+	REQUIRE(sample.count == 2);
+	REQUIRE(samples.pop(sample));
+	REQUIRE(sample.inputs == 0x0000);
+	REQUIRE(sample.count == 1);
+	REQUIRE(capture.get_sample_count() == 6);
+}
+
+TEST_CASE("Capture Overflow And Failure", "[mcp23017_capture]") {
+	reset_for_test(&capture_i2c);
+	Mcp23017_simulator chip(&capture_i2c, 0x20);
+	Mcp23017 mcp_capture(&capture_i2c, 0x20);
+	Mcp23017_ring<Mcp23017_capture_sample, 4> samples;
+	Mcp23017_capture<4> capture(mcp_capture, samples);
+
+	REQUIRE(capture.capture(10) == PICO_ERROR_NONE);
+	REQUIRE(samples.size() == 4);
+	REQUIRE(samples.get_overflow_count() == 6);
+
+	Mcp23017_capture_sample sample{};
+	while (samples.pop(sample)) {
+	}
+	mock_queue_i2c_result(PICO_ERROR_NONE, 1); //IOCON
+	mock_queue_i2c_result(PICO_ERROR_TIMEOUT, 1); //the pointer
+	REQUIRE(capture.capture(10) == MCP23017_ERROR_TIMEOUT);
+	REQUIRE(samples.empty());
+	REQUIRE((chip.peek(MCP23017_IOCONA) & (1 << MCP23017_IOCON_SEQOP_BIT)) == 0);
+}
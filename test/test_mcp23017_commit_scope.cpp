@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "mcp23017.h"
+#include "mcp23017_commit_scope.h"
+#include "mcp23017_private.h"
+#include "mcp23017_simulator.h"
+
+static i2c_inst_t commit_i2c{};
+
+TEST_CASE("Commit Scope Coalesces Flushes", "[mcp23017_commit_scope]") {
+	reset_for_test(&commit_i2c);
+	Mcp23017_simulator chip0(&commit_i2c, 0x20);
+	Mcp23017_simulator chip1(&commit_i2c, 0x21);
+	Mcp23017 mcp0(&commit_i2c, 0x20);
+	Mcp23017 mcp1(&commit_i2c, 0x21);
+	Mcp23017 mcp2(&commit_i2c, 0x22);
+	mcp0.set_all_output_bits(0x0000);
+	mcp1.set_all_output_bits(0x0000);
+	mcp2.set_all_output_bits(0x0000);
+
+	reset_bus_stats();
+	{
+		Mcp23017_commit_scope commit({&mcp0, &mcp1, &mcp2});
+		for (int pin = 0; pin < 8; pin++) {
+			mcp0.set_output_bit_for_pin(pin, true);
+			REQUIRE(mcp0.flush_output() == PICO_ERROR_NONE);
+		}
+		mcp1.set_output_bit_for_pin(15, true);
+		mcp1.flush_output();
+		REQUIRE(mock_bus_stats.transactions == 0);
+		REQUIRE(chip0.peek(MCP23017_OLATA) == 0x00);
+	}
+	REQUIRE(mock_bus_stats.transactions == 2);
+	REQUIRE(chip0.peek_pair(MCP23017_OLATA) == 0x00ff);
+	REQUIRE(chip1.peek_pair(MCP23017_OLATA) == 0x8000);
+
+	reset_bus_stats();
+	mcp0.set_output_bit_for_pin(0, false);
+	REQUIRE(mcp0.flush_output() == PICO_ERROR_NONE);
+	REQUIRE(mock_bus_stats.transactions == 1);
+}
+
+TEST_CASE("Commit Scope Nesting And Immediate Writes", "[mcp23017_commit_scope]") {
+	reset_for_test(&commit_i2c);
+	Mcp23017_simulator chip(&commit_i2c, 0x23);
+	Mcp23017 mcp_commit(&commit_i2c, 0x23);
+	mcp_commit.set_all_output_bits(0x0000);
+
+	Mcp23017_commit_scope outer(mcp_commit);
+	{
+		Mcp23017_commit_scope inner(mcp_commit);
+		mcp_commit.set_output_bit_for_pin(1, true);
+		mcp_commit.flush_output();
+		REQUIRE(inner.commit() == PICO_ERROR_NONE);
+		REQUIRE(chip.peek(MCP23017_OLATA) == 0x00);
+	}
+	mcp_commit.set_output_bit_for_pin(9, true);
+	REQUIRE(mcp_commit.flush_output_immediate() == PICO_ERROR_NONE);
+	REQUIRE(chip.peek_pair(MCP23017_OLATA) == 0x0202);
+
+	mcp_commit.set_output_bit_for_pin(2, true);
+	mcp_commit.flush_output();
+	REQUIRE(chip.peek(MCP23017_OLATA) == 0x02);
+	REQUIRE(outer.commit() == PICO_ERROR_NONE);
+	REQUIRE(chip.peek(MCP23017_OLATA) == 0x06);
+
+	Mcp23017_commit_scope failing(mcp_commit);
+	mcp_commit.set_output_bit_for_pin(3, true);
+	mcp_commit.flush_output();
+	mock_queue_i2c_result(PICO_ERROR_TIMEOUT, 1);
+	REQUIRE(failing.commit() == MCP23017_ERROR_TIMEOUT);
+}
+
+TEST_CASE("Commit Scope Coil Pulse Reaches The Device", "[mcp23017_commit_scope]") {
+	reset_for_test(&commit_i2c);
+	Mcp23017_simulator chip(&commit_i2c, 0x24);
+	Mcp23017 mcp_commit(&commit_i2c, 0x24);
+	mcp_commit.set_all_output_bits(0x0000);
+	std::vector<uint16_t> log;
+	chip.set_output_log(&log);
+	const uint16_t coils = 0x0030;
+
+	{
+		Mcp23017_commit_scope commit(mcp_commit);
+		//as a latching output does, drive the on coil then release it once the relay has moved
+		mcp_commit.write_bits(coils, 0x0020);
+		mcp_commit.flush_output();
+		REQUIRE(!mcp_commit.is_output_flushed(coils));
+		REQUIRE(mcp_commit.is_output_flushed(0xff00));
+		REQUIRE(mcp_commit.flush_output_immediate() == PICO_ERROR_NONE);
+		REQUIRE(mcp_commit.is_output_flushed(coils));
+		mcp_commit.clear_bits(coils);
+		mcp_commit.flush_output();
+		REQUIRE(!mcp_commit.is_output_flushed(coils));
+	}
+	REQUIRE(mcp_commit.is_output_flushed(0xffff));
+	REQUIRE(!log.empty());
+	REQUIRE(log.front() == 0x0020);
+	REQUIRE(log.back() == 0x0000);
+	chip.set_output_log(nullptr);
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "mcp23017.h"
+#include "mcp23017_debouncer.h"
+#include "mcp23017_simulator.h"
+
+static i2c_inst_t debounce_i2c{};
+
+TEST_CASE("Debouncer Depth One Follows Input", "[mcp23017_debouncer]") {
+	Mcp23017_debouncer<uint16_t> debouncer;
+
+	REQUIRE(debouncer.update(0x00f0) == 0);
+	REQUIRE(debouncer.get_stable() == 0x00f0);
+	REQUIRE(debouncer.update(0x00f1) == 0x0001);
+	REQUIRE(debouncer.get_stable() == 0x00f1);
+	REQUIRE(debouncer.update(0x0001) == 0x00f0);
+	REQUIRE(debouncer.get_stable() == 0x0001);
+}
+
+TEST_CASE("Debouncer Ignores Chatter", "[mcp23017_debouncer]") {
+	Mcp23017_debouncer<uint16_t> debouncer(3);
+	debouncer.update(0x0000);
+
+	REQUIRE(debouncer.update(0x0003) == 0);
+	REQUIRE(debouncer.update(0x0001) == 0); //pin 1 chatters back, its count restarts
+	REQUIRE(debouncer.update(0x0003) == 0x0001);
+	REQUIRE(debouncer.get_stable() == 0x0001);
+	REQUIRE(debouncer.update(0x0003) == 0);
+	REQUIRE(debouncer.update(0x0003) == 0x0002);
+	REQUIRE(debouncer.get_stable() == 0x0003);
+	REQUIRE(debouncer.get_changed() == 0x0002);
+}
+
+TEST_CASE("Debouncer Maximum Depth Wide Word", "[mcp23017_debouncer]") {
+	Mcp23017_debouncer<uint64_t> debouncer(MCP23017_DEBOUNCE_MAX_DEPTH);
+	debouncer.update(0);
+	const uint64_t pressed = 0x8000000000000001ull;
+
+	for (int i = 1; i < MCP23017_DEBOUNCE_MAX_DEPTH; i++) {
+		REQUIRE(debouncer.update(pressed) == 0);
+	}
+	REQUIRE(debouncer.update(pressed) == pressed);
+	REQUIRE(debouncer.get_stable() == pressed);
+}
+
+TEST_CASE("Device Debounces Input Snapshots", "[mcp23017_debouncer]") {
+	reset_for_test(&debounce_i2c);
+	Mcp23017_simulator chip(&debounce_i2c, 0x20);
+	Mcp23017 mcp_debounce(&debounce_i2c, 0x20);
+	mcp_debounce.set_debounce_depth(2);
+
+	chip.set_input_levels(0x0000);
+	mcp_debounce.update_and_get_input_values();
+	chip.set_input_levels(0x0100);
+	mcp_debounce.update_and_get_input_values();
+	REQUIRE(mcp_debounce.get_last_input_pin_values() == 0x0100);
+	REQUIRE(!mcp_debounce.get_debounced_input_pin_value(8));
+
+	Mcp23017_interrupt_state state{};
+	mcp_debounce.service_interrupt(state);
+	REQUIRE(mcp_debounce.get_debounced_input_pin_value(8));
+	REQUIRE(mcp_debounce.get_debounced_input_pin_values() == 0x0100);
+	REQUIRE(mcp_debounce.get_debounced_changed_mask() == 0x0100);
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+
+#include "mcp23017.h"
+#include "mcp23017_dispatcher.h"
+#include "mcp23017_simulator.h"
+
+static i2c_inst_t dispatch_i2c{};
+
+struct Pin_change {
+	int pin;
+	bool value;
+};
+
+static void record_pin(Mcp23017 &, int pin, bool value, void *context) {
+	static_cast<std::vector<Pin_change> *>(context)->push_back({pin, value});
+}
+
+static void record_mask(Mcp23017 &, uint16_t changed, uint16_t, void *context) {
+	static_cast<std::vector<uint16_t> *>(context)->push_back(changed);
+}
+
+TEST_CASE("Dispatch Every Changed Pin", "[mcp23017_dispatcher]") {
+	reset_for_test(&dispatch_i2c);
+	Mcp23017_simulator chip(&dispatch_i2c, 0x20);
+	Mcp23017 mcp_dispatch(&dispatch_i2c, 0x20);
+	Mcp23017_dispatcher dispatcher(mcp_dispatch);
+	std::vector<Pin_change> pins;
+	std::vector<uint16_t> masks;
+	for (int pin = 0; pin < 16; pin++) {
+		REQUIRE(dispatcher.on_pin(pin, record_pin, &pins) == PICO_ERROR_NONE);
+	}
+	REQUIRE(dispatcher.on_pin(16, record_pin, &pins) == PICO_ERROR_GENERIC);
+	REQUIRE(dispatcher.on_mask(0xff00, record_mask, &masks) == PICO_ERROR_NONE);
+
+	chip.set_input_levels(0x8101);
+	REQUIRE(dispatcher.poll() == PICO_ERROR_NONE);
+	REQUIRE(pins.size() == 3);
+	REQUIRE(pins[0].pin == 0);
+	REQUIRE(pins[1].pin == 8);
+	REQUIRE(pins[2].pin == 15);
+	REQUIRE(pins[2].value);
+	REQUIRE(masks.size() == 1);
+	REQUIRE(masks[0] == 0x8100);
+
+	pins.clear();
+	REQUIRE(dispatcher.poll() == PICO_ERROR_NONE);
+	REQUIRE(pins.empty());
+
+	chip.set_input_levels(0x0101);
+	REQUIRE(dispatcher.poll() == PICO_ERROR_NONE);
+	REQUIRE(pins.size() == 1);
+	REQUIRE(pins[0].pin == 15);
+	REQUIRE(!pins[0].value);
+}
+
+TEST_CASE("Dispatch Interrupt Flags", "[mcp23017_dispatcher]") {
+	reset_for_test(&dispatch_i2c);
+	Mcp23017_simulator chip(&dispatch_i2c, 0x21);
+	Mcp23017 mcp_dispatch(&dispatch_i2c, 0x21);
+	Mcp23017_dispatcher dispatcher(mcp_dispatch);
+	std::vector<Pin_change> pins;
+	dispatcher.on_pin(2, record_pin, &pins);
+	dispatcher.on_pin(3, record_pin, &pins);
+	Mcp23017_config config;
+	config.interrupt_enable = 0xffff;
+	mcp_dispatch.apply(config);
+
+	chip.set_input_levels(0x0004);
+	chip.set_input_levels(0x0000); //pin 2 flipped back before being serviced
+	REQUIRE(dispatcher.service_interrupt() == PICO_ERROR_NONE);
+	REQUIRE(pins.size() == 1);
+	REQUIRE(pins[0].pin == 2);
+	REQUIRE(!pins[0].value);
+}
+
+TEST_CASE("Dispatch Skips Pins Without Handlers", "[mcp23017_dispatcher]") {
+	Mcp23017 mcp_dispatch(&dispatch_i2c, 0x22);
+	Mcp23017_dispatcher dispatcher(mcp_dispatch);
+	std::vector<Pin_change> pins;
+	dispatcher.on_pin(4, record_pin, &pins);
+	dispatcher.on_pin(5, record_pin, &pins);
+	dispatcher.on_pin(5, nullptr, nullptr);
+
+	dispatcher.dispatch(0xffff, 0x0010);
+	REQUIRE(pins.size() == 1);
+	REQUIRE(pins[0].pin == 4);
+	REQUIRE(pins[0].value);
+}
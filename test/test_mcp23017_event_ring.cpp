@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+
+#include "mcp23017_event_ring.h"
+
+static i2c_inst_t ring_i2c{};
+
+TEST_CASE("Ring Push Pop", "[mcp23017_event_ring]") {
+	Mcp23017_ring<int, 4> ring;
+	int value;
+
+	REQUIRE(ring.empty());
+	REQUIRE(!ring.pop(value));
+	for (int i = 0; i < 4; i++) {
+		REQUIRE(ring.push(i));
+	}
+	REQUIRE(!ring.push(4));
+	REQUIRE(ring.get_overflow_count() == 1);
+	REQUIRE(ring.size() == 4);
+	REQUIRE(ring.pop(value));
+	REQUIRE(value == 0);
+	REQUIRE(ring.push(5));
+	for (int expected : {1, 2, 3, 5}) {
+		REQUIRE(ring.pop(value));
+		REQUIRE(value == expected);
+	}
+	REQUIRE(ring.empty());
+}
+
+static void collect_event(const Mcp23017_interrupt_event &event, void *context) {
+	static_cast<std::vector<Mcp23017_interrupt_event> *>(context)->push_back(event);
+}
+
+TEST_CASE("Interrupt Ring Records And Drains", "[mcp23017_event_ring]") {
+	reset_for_test(&ring_i2c);
+	Mcp23017 mcp0(&ring_i2c, 0x20);
+	Mcp23017 mcp1(&ring_i2c, 0x21);
+	Mcp23017_interrupt_ring<8> ring;
+	std::vector<Mcp23017_interrupt_event> events;
+
+	mock_time_us = 1000;
+	REQUIRE(ring.record(mcp0));
+	mock_time_us = 1250;
+	REQUIRE(ring.record(mcp1));
+	REQUIRE(ring.pending() == 2);
+
+	std::vector<uint8_t> data = {0x01, 0x00, 0x01, 0x00, 0x01, 0x00,
+								 0x00, 0x80, 0x00, 0x00, 0x00, 0x00};
+	set_read_data(data, 12);
+	REQUIRE(ring.drain(collect_event, &events) == 2);
+
+	REQUIRE(ring.pending() == 0);
+	REQUIRE(events.size() == 2);
+	REQUIRE(events[0].device == &mcp0);
+	REQUIRE(events[0].timestamp_us == 1000);
+	REQUIRE(events[0].serviced);
+	REQUIRE(events[0].state.flags == 0x0001);
+	REQUIRE(events[0].state.captured == 0x0001);
+	REQUIRE(events[1].device == &mcp1);
+	REQUIRE(events[1].timestamp_us == 1250);
+	REQUIRE(events[1].state.flags == 0x8000);
+	REQUIRE(events[1].state.captured == 0x0000);
+	REQUIRE(mcp0.get_last_input_pin_values() == 0x0001);
+}
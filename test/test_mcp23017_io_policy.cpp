@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "mcp23017.h"
+#include "mcp23017_bus.h"
+#include "mcp23017_private.h"
+#include "mcp23017_simulator.h"
+
+static i2c_inst_t policy_i2c{};
+
+static const uint SDA_GPIO = 20;
+static const uint SCL_GPIO = 21;
+
+TEST_CASE("Transfers Have A Deadline", "[mcp23017_io_policy]") {
+	reset_for_test(&policy_i2c);
+	Mcp23017_simulator chip(&policy_i2c, 0x20);
+	Mcp23017 mcp_policy(&policy_i2c, 0x20);
+
+	REQUIRE(mcp_policy.set_io_direction(0x0000) == PICO_ERROR_NONE);
+	REQUIRE(mock_last_timeout_us == MCP23017_DEFAULT_TIMEOUT_US);
+
+	Mcp23017_io_policy policy;
+	policy.timeout_us = 500;
+	mcp_policy.set_io_policy(policy);
+	REQUIRE(mcp_policy.update_and_get_input_values() == PICO_ERROR_NONE);
+	REQUIRE(mock_last_timeout_us == 500);
+}
+
+TEST_CASE("Distinct Error Codes", "[mcp23017_io_policy]") {
+	reset_for_test(&policy_i2c);
+	Mcp23017_simulator chip(&policy_i2c, 0x20);
+	Mcp23017 mcp_policy(&policy_i2c, 0x20);
+
+	mock_queue_i2c_result(PICO_ERROR_TIMEOUT, 1);
+	REQUIRE(mcp_policy.update_and_get_input_values() == MCP23017_ERROR_TIMEOUT);
+
+	mock_queue_i2c_result(PICO_ERROR_GENERIC, 1);
+	REQUIRE(mcp_policy.get_interrupt_values() == MCP23017_ERROR_NACK);
+
+	mock_queue_i2c_result(PICO_ERROR_TIMEOUT, 1);
+	REQUIRE(mcp_policy.get_last_interrupt_pin() == MCP23017_ERROR_TIMEOUT);
+
+	mock_queue_i2c_result(PICO_ERROR_TIMEOUT, 1);
+	REQUIRE(mcp_policy.set_all_output_bits(0x1234) == MCP23017_ERROR_TIMEOUT);
+	REQUIRE_FALSE(mcp_policy.is_register_valid(MCP23017_OLATA));
+	REQUIRE(mcp_policy.flush_output() == PICO_ERROR_NONE);
+	REQUIRE(chip.peek_pair(MCP23017_OLATA) == 0x1234);
+}
+
+TEST_CASE("Retries With Backoff", "[mcp23017_io_policy]") {
+	reset_for_test(&policy_i2c);
+	Mcp23017_simulator chip(&policy_i2c, 0x20);
+	Mcp23017 mcp_policy(&policy_i2c, 0x20);
+	Mcp23017_io_policy policy;
+	policy.timeout_us = 1000;
+	policy.retries = 3;
+	policy.backoff_us = 100;
+	policy.max_backoff_us = 150;
+	mcp_policy.set_io_policy(policy);
+	chip.set_input_levels(0xa5a5);
+
+	//the read of the first attempt and the pointer write of the second fail
+	mock_queue_i2c_result(PICO_ERROR_NONE, 1);
+	mock_queue_i2c_result(PICO_ERROR_TIMEOUT, 1);
+	mock_queue_i2c_result(PICO_ERROR_GENERIC, 1);
+	REQUIRE(mcp_policy.update_and_get_input_values() == PICO_ERROR_NONE);
+	REQUIRE(mcp_policy.get_last_input_pin_values() == 0xa5a5);
+	REQUIRE(mock_time_us == 1000 + 100 + 150);
+
+	reset_for_test(&policy_i2c);
+	mock_queue_i2c_result(PICO_ERROR_GENERIC, 4);
+	REQUIRE(mcp_policy.set_io_direction(0x0f0f) == MCP23017_ERROR_NACK);
+	REQUIRE(mock_time_us == 100 + 150 + 150);
+	REQUIRE(mcp_policy.set_io_direction(0x0f0f) == PICO_ERROR_NONE);
+	REQUIRE(chip.peek_pair(MCP23017_IODIRA) == 0x0f0f);
+}
+
+TEST_CASE("Bus Recovery", "[mcp23017_io_policy]") {
+	reset_for_test(&policy_i2c);
+	mock_sda_stuck_clocks = 4;
+	REQUIRE(mcp23017_recover_bus(SDA_GPIO, SCL_GPIO) == PICO_ERROR_NONE);
+	REQUIRE(mock_gpio_rising_edges(SCL_GPIO) == 4 + 1); //and the stop
+	REQUIRE(mock_gpio_rising_edges(SDA_GPIO) == 1); //the stop
+	REQUIRE(mock_gpio_driven_high == 0);
+	REQUIRE(mock_gpio_get_function(SDA_GPIO) == GPIO_FUNC_I2C);
+	REQUIRE(mock_gpio_get_function(SCL_GPIO) == GPIO_FUNC_I2C);
+	REQUIRE(mock_time_us <= MCP23017_RECOVERY_MAX_US);
+
+	reset_for_test(&policy_i2c);
+	mock_sda_stuck_clocks = -1;
+	REQUIRE(mcp23017_recover_bus(SDA_GPIO, SCL_GPIO) == MCP23017_ERROR_BUS_STUCK);
+	REQUIRE(mock_gpio_rising_edges(SCL_GPIO) == MCP23017_RECOVERY_CLOCKS + 1);
+	REQUIRE(mock_gpio_driven_high == 0);
+	REQUIRE(mock_time_us == MCP23017_RECOVERY_MAX_US);
+	REQUIRE(mock_gpio_get_function(SCL_GPIO) == GPIO_FUNC_I2C);
+}
+
+TEST_CASE("Recovery Between Retries", "[mcp23017_io_policy]") {
+	reset_for_test(&policy_i2c);
+	Mcp23017_simulator chip(&policy_i2c, 0x20);
+	Mcp23017 mcp_policy(&policy_i2c, 0x20);
+	Mcp23017_io_policy policy;
+	policy.retries = 2;
+	policy.sda_gpio = SDA_GPIO;
+	policy.scl_gpio = SCL_GPIO;
+	mcp_policy.set_io_policy(policy);
+
+	//a nack doesn't need recovery
+	mock_queue_i2c_result(PICO_ERROR_GENERIC, 1);
+	REQUIRE(mcp_policy.set_io_direction(0x00ff) == PICO_ERROR_NONE);
+	REQUIRE(mock_gpio_rising_edges(SCL_GPIO) == 0);
+
+	mock_sda_stuck_clocks = 3;
+	mock_queue_i2c_result(PICO_ERROR_TIMEOUT, 1);
+	REQUIRE(mcp_policy.set_pullup(0xff00) == PICO_ERROR_NONE);
+	REQUIRE(mock_gpio_rising_edges(SCL_GPIO) == 3 + 1);
+	REQUIRE(chip.peek_pair(MCP23017_GPPUA) == 0xff00);
+
+	mock_sda_stuck_clocks = -1;
+	mock_queue_i2c_result(PICO_ERROR_TIMEOUT, 1);
+	REQUIRE(mcp_policy.set_pullup(0x0000) == MCP23017_ERROR_BUS_STUCK);
+}
+
+TEST_CASE("Worst Case Latency Bound", "[mcp23017_io_policy]") {
+	reset_for_test(&policy_i2c);
+	Mcp23017_simulator chip(&policy_i2c, 0x20);
+	Mcp23017 mcp_policy(&policy_i2c, 0x20);
+	Mcp23017_io_policy policy;
+	policy.timeout_us = 2000;
+	policy.retries = 4;
+	policy.backoff_us = 200;
+	policy.max_backoff_us = 1000;
+	mcp_policy.set_io_policy(policy);
+
+	REQUIRE(mcp23017_worst_case_latency_us(policy, 1) == 5 * 2000 + 200 + 400 + 800 + 1000);
+	REQUIRE(mcp_policy.get_worst_case_latency_us() == 5 * 2 * 2000 + 200 + 400 + 800 + 1000);
+
+	//every read times out on the last byte, the longest a read can take
+	for (int attempt = 0; attempt <= policy.retries; attempt++) {
+		mock_queue_i2c_result(PICO_ERROR_NONE, 1);
+		mock_queue_i2c_result(PICO_ERROR_TIMEOUT, 1);
+	}
+	REQUIRE(mcp_policy.update_and_get_input_values() == MCP23017_ERROR_TIMEOUT);
+	REQUIRE(mock_time_us <= mcp_policy.get_worst_case_latency_us());
+
+	policy.sda_gpio = SDA_GPIO;
+	policy.scl_gpio = SCL_GPIO;
+	mcp_policy.set_io_policy(policy);
+	REQUIRE(mcp_policy.get_worst_case_latency_us() == 5 * 2 * 2000 + 200 + 400 + 800 + 1000 + 4 * MCP23017_RECOVERY_MAX_US);
+}
+
+TEST_CASE("Bus Poll Retries A Failed Device", "[mcp23017_io_policy]") {
+	reset_for_test(&policy_i2c);
+	Mcp23017_simulator chip0(&policy_i2c, 0x20);
+	Mcp23017_simulator chip1(&policy_i2c, 0x21);
+	Mcp23017 mcp0(&policy_i2c, 0x20);
+	Mcp23017 mcp1(&policy_i2c, 0x21);
+	Mcp23017_io_policy policy;
+	policy.retries = 1;
+	mcp0.set_io_policy(policy);
+	Mcp23017_bus bus(&policy_i2c);
+	bus.add_device(mcp0);
+	bus.add_device(mcp1);
+	chip0.set_input_levels(0x1111);
+	chip1.set_input_levels(0x2222);
+
+	mock_queue_i2c_result(PICO_ERROR_GENERIC, 1);
+	REQUIRE(bus.poll_all() == PICO_ERROR_NONE);
+	REQUIRE(bus.get_snapshot()[0] == 0x1111);
+	REQUIRE(bus.get_snapshot()[1] == 0x2222);
+
+	mock_queue_i2c_result(PICO_ERROR_NONE, 2);
+	mock_queue_i2c_result(PICO_ERROR_TIMEOUT, 1);
+	REQUIRE(bus.poll_all() == MCP23017_ERROR_TIMEOUT);
+	REQUIRE(bus.get_snapshot()[0] == 0x1111);
+}
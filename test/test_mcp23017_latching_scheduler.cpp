@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "mcp23017.h"
+#include "mcp23017_latching_scheduler.h"
+#include "mcp23017_private.h"
+#include "mcp23017_simulator.h"
+
+static i2c_inst_t relay_i2c{};
+
+TEST_CASE("Scheduler Shares Flushes Per Device", "[mcp23017_latching_scheduler]") {
+	reset_for_test(&relay_i2c);
+	Mcp23017_simulator chip0(&relay_i2c, 0x20);
+	Mcp23017_simulator chip1(&relay_i2c, 0x21);
+	Mcp23017 mcp0(&relay_i2c, 0x20);
+	Mcp23017 mcp1(&relay_i2c, 0x21);
+	mcp0.set_all_output_bits(0x0000);
+	mcp1.set_all_output_bits(0x0000);
+	Mcp23017_latching_scheduler scheduler(20000);
+	for (int i = 0; i < 8; i++) {
+		REQUIRE(scheduler.add_relay(mcp0, i * 2, i * 2 + 1) == i);
+	}
+	for (int i = 0; i < 4; i++) {
+		REQUIRE(scheduler.add_relay(mcp1, i * 2, i * 2 + 1) == 8 + i);
+	}
+	REQUIRE(scheduler.add_relay(mcp1, 16, 0) == PICO_ERROR_GENERIC);
+
+	for (int i = 0; i < 12; i++) {
+		REQUIRE(scheduler.request(i, i % 2 == 0) == PICO_ERROR_NONE);
+	}
+	REQUIRE(!scheduler.is_idle());
+
+	reset_bus_stats();
+	REQUIRE(scheduler.tick(1000) == PICO_ERROR_NONE);
+	REQUIRE(mock_bus_stats.transactions == 2);
+	REQUIRE(chip0.peek_pair(MCP23017_OLATA) == 0x6666); //on, off, on, off...
+	REQUIRE(chip1.peek_pair(MCP23017_OLATA) == 0x0066);
+
+	reset_bus_stats();
+	REQUIRE(scheduler.tick(20999) == PICO_ERROR_NONE);
+	REQUIRE(mock_bus_stats.transactions == 0);
+
+	REQUIRE(scheduler.tick(21000) == PICO_ERROR_NONE);
+	REQUIRE(mock_bus_stats.transactions == 2);
+	REQUIRE(chip0.peek_pair(MCP23017_OLATA) == 0x0000);
+	REQUIRE(chip1.peek_pair(MCP23017_OLATA) == 0x0000);
+	REQUIRE(scheduler.is_idle());
+}
+
+TEST_CASE("Scheduler Request During Pulse", "[mcp23017_latching_scheduler]") {
+	reset_for_test(&relay_i2c);
+	Mcp23017_simulator chip(&relay_i2c, 0x22);
+	Mcp23017 mcp_relay(&relay_i2c, 0x22);
+	Mcp23017_latching_scheduler scheduler(10000);
+	int relay = scheduler.add_relay(mcp_relay, 4, 5);
+
+	scheduler.request(relay, true);
+	scheduler.tick(0);
+	REQUIRE(chip.peek(MCP23017_OLATA) == 0b00100000);
+	scheduler.request(relay, false);
+	scheduler.tick(5000);
+	REQUIRE(chip.peek(MCP23017_OLATA) == 0b00100000);
+	scheduler.tick(10000);
+	REQUIRE(chip.peek(MCP23017_OLATA) == 0b00010000);
+	scheduler.tick(20000);
+	REQUIRE(chip.peek(MCP23017_OLATA) == 0b00000000);
+	REQUIRE(scheduler.request(relay + 1, true) == PICO_ERROR_GENERIC);
+}
+
+TEST_CASE("Scheduler Runs From Timer", "[mcp23017_latching_scheduler]") {
+	reset_for_test(&relay_i2c);
+	Mcp23017_simulator chip(&relay_i2c, 0x23);
+	Mcp23017 mcp_relay(&relay_i2c, 0x23);
+	Mcp23017_latching_scheduler scheduler(1000);
+	int relay = scheduler.add_relay(mcp_relay, 8, 9);
+
+	REQUIRE(scheduler.start(1000));
+	REQUIRE(!scheduler.start(1000));
+	scheduler.request(relay, true);
+	mock_time_us = 100;
+	reset_bus_stats();
+	REQUIRE(mock_run_timers() == 1);
+	REQUIRE(mock_bus_stats.transactions == 0); //the timer only stages
+	REQUIRE(chip.peek(MCP23017_OLATB) == 0);
+	REQUIRE(scheduler.service() == PICO_ERROR_NONE);
+	REQUIRE(chip.peek(MCP23017_OLATB) == 0b10);
+	reset_bus_stats();
+	REQUIRE(scheduler.service() == PICO_ERROR_NONE);
+	REQUIRE(mock_bus_stats.transactions == 0);
+	mock_time_us = 1100;
+	mock_run_timers();
+	REQUIRE(scheduler.service() == PICO_ERROR_NONE);
+	REQUIRE(chip.peek(MCP23017_OLATB) == 0);
+	scheduler.stop();
+	REQUIRE(mock_run_timers() == 0);
+}
+
+TEST_CASE("Scheduler Timer Ticks Before Service", "[mcp23017_latching_scheduler]") {
+	reset_for_test(&relay_i2c);
+	Mcp23017_simulator chip(&relay_i2c, 0x24);
+	Mcp23017 mcp_relay(&relay_i2c, 0x24);
+	std::vector<uint16_t> log;
+	chip.set_output_log(&log);
+	Mcp23017_latching_scheduler scheduler(1000);
+	int relay = scheduler.add_relay(mcp_relay, 8, 9);
+
+	REQUIRE(scheduler.start(1000));
+	scheduler.request(relay, true);
+	mock_time_us = 100;
+	mock_run_timers();
+	mock_time_us = 1100;
+	mock_run_timers(); //the pulse hasn't been written so it must not be released yet
+	REQUIRE(!scheduler.is_idle());
+	REQUIRE(scheduler.service() == PICO_ERROR_NONE);
+	REQUIRE(chip.peek(MCP23017_OLATB) == 0b10);
+	REQUIRE(!log.empty());
+
+	mock_time_us = 2000;
+	mock_run_timers(); //timed from the service at 1100
+	REQUIRE(scheduler.service() == PICO_ERROR_NONE);
+	REQUIRE(chip.peek(MCP23017_OLATB) == 0b10);
+	mock_time_us = 2100;
+	mock_run_timers();
+	REQUIRE(scheduler.service() == PICO_ERROR_NONE);
+	REQUIRE(chip.peek(MCP23017_OLATB) == 0);
+	REQUIRE(scheduler.is_idle());
+	scheduler.stop();
+	chip.set_output_log(nullptr);
+}
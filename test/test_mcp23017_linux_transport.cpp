@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifdef __linux__
+
+#include <catch2/catch_test_macros.hpp>
+#include <cerrno>
+#include <vector>
+
+#include "mcp23017.h"
+#include "mcp23017_bus.h"
+#include "mcp23017_linux_transport.h"
+#include "mcp23017_private.h"
+#include "mcp23017_simulator.h"
+
+static i2c_inst_t linux_i2c{};
+
+/**
+ * Stands in for i2c-dev, passing each I2C_RDWR message to the simulator at its address
+ */
+class Fake_i2c_dev : public Mcp23017_linux_transport {
+public:
+	std::vector<uint32_t> combined; //messages in each I2C_RDWR
+	unsigned long timeout_units{};
+	int timeout_sets{};
+	int fail_errno{}; //makes the next I2C_RDWR fail
+
+protected:
+	int control(unsigned long request, unsigned long argument) override {
+		if (request == I2C_TIMEOUT) {
+			timeout_units = argument;
+			timeout_sets++;
+			return 0;
+		}
+		if (request != I2C_RDWR) {
+			errno = ENOTTY;
+			return -1;
+		}
+		if (fail_errno) {
+			errno = fail_errno;
+			fail_errno = 0;
+			return -1;
+		}
+		auto data = reinterpret_cast<i2c_rdwr_ioctl_data *>(argument);
+		combined.push_back(data->nmsgs);
+		for (uint32_t i = 0; i < data->nmsgs; i++) {
+			i2c_msg &message = data->msgs[i];
+			Mcp23017_simulator *simulator = find_simulator(&linux_i2c, message.addr);
+			if (simulator == nullptr) {
+				errno = ENXIO;
+				return -1;
+			}
+			if (message.flags & I2C_M_RD) {
+				simulator->read(message.buf, message.len);
+			} else {
+				simulator->write(message.buf, message.len);
+			}
+		}
+		return static_cast<int>(data->nmsgs);
+	}
+};
+
+TEST_CASE("Linux Transport Register Access", "[mcp23017_linux_transport]") {
+	reset_for_test(&linux_i2c);
+	Mcp23017_simulator chip(&linux_i2c, 0x20);
+	Fake_i2c_dev i2c_dev;
+	Mcp23017 mcp_linux(i2c_dev, 0x20);
+	REQUIRE(mcp_linux.get_i2c() == nullptr);
+	REQUIRE(&mcp_linux.get_transport() == &i2c_dev);
+
+	REQUIRE(mcp_linux.set_io_direction(0xffff) == PICO_ERROR_NONE);
+	REQUIRE(i2c_dev.combined == std::vector<uint32_t>{1});
+	REQUIRE(chip.peek_pair(MCP23017_IODIRA) == 0xffff);
+
+	//the register write and the read go out as one combined message
+	chip.set_input_levels(0xa55a);
+	REQUIRE(mcp_linux.update_and_get_input_values() == PICO_ERROR_NONE);
+	REQUIRE(mcp_linux.get_last_input_pin_values() == 0xa55a);
+	REQUIRE(i2c_dev.combined == std::vector<uint32_t>{1, 2});
+
+	//the adapter timeout is only set when the deadline changes
+	REQUIRE(i2c_dev.timeout_units == 1);
+	REQUIRE(i2c_dev.timeout_sets == 1);
+	Mcp23017_io_policy policy;
+	policy.timeout_us = 25000;
+	mcp_linux.set_io_policy(policy);
+	REQUIRE(mcp_linux.update_and_get_input_values() == PICO_ERROR_NONE);
+	REQUIRE(i2c_dev.timeout_units == 3);
+	REQUIRE(i2c_dev.timeout_sets == 2);
+}
+
+TEST_CASE("Linux Transport Errors", "[mcp23017_linux_transport]") {
+	reset_for_test(&linux_i2c);
+	Mcp23017_simulator chip(&linux_i2c, 0x20);
+	Fake_i2c_dev i2c_dev;
+	Mcp23017 mcp_linux(i2c_dev, 0x20);
+	Mcp23017 mcp_missing(i2c_dev, 0x21);
+
+	REQUIRE(mcp_missing.update_and_get_input_values() == MCP23017_ERROR_NACK);
+	i2c_dev.fail_errno = ETIMEDOUT;
+	REQUIRE(mcp_linux.update_and_get_input_values() == MCP23017_ERROR_TIMEOUT);
+	REQUIRE(mcp_linux.set_io_direction(0x0000) == PICO_ERROR_NONE);
+
+	//without an open device file the real ioctl fails
+	Mcp23017_linux_transport closed;
+	REQUIRE_FALSE(closed.is_open());
+	Mcp23017 mcp_closed(closed, 0x20);
+	REQUIRE(mcp_closed.update_and_get_input_values() < PICO_ERROR_NONE);
+}
+
+TEST_CASE("Linux Transport Scans And Streams", "[mcp23017_linux_transport]") {
+	reset_for_test(&linux_i2c);
+	Mcp23017_simulator chip(&linux_i2c, 0x20);
+	Fake_i2c_dev i2c_dev;
+	Mcp23017 mcp_linux(i2c_dev, 0x20);
+	REQUIRE(mcp_linux.set_io_direction(0xff00) == PICO_ERROR_NONE);
+
+	//each row write is combined with its column read
+	i2c_dev.combined.clear();
+	const uint8_t drives[] = {0xfe, 0xfd, 0xfb, 0xf7};
+	uint8_t columns[4]{};
+	REQUIRE(mcp_linux.scan_matrix(drives, columns, 4) == PICO_ERROR_NONE);
+	REQUIRE(i2c_dev.combined == std::vector<uint32_t>{2, 2, 2, 2});
+	REQUIRE(chip.peek(MCP23017_OLATA) == 0xf7);
+
+	const uint16_t words[] = {0x0001, 0x0002, 0x0003};
+	REQUIRE(mcp_linux.stream_output(words, 3) == PICO_ERROR_NONE);
+	REQUIRE(chip.peek_pair(MCP23017_OLATA) == 0x0003);
+}
+
+TEST_CASE("Linux Transport Bus", "[mcp23017_linux_transport]") {
+	reset_for_test(&linux_i2c);
+	Mcp23017_simulator chip0(&linux_i2c, 0x20);
+	Mcp23017_simulator chip1(&linux_i2c, 0x21);
+	Fake_i2c_dev i2c_dev;
+	Fake_i2c_dev other_dev;
+	Mcp23017 mcp0(i2c_dev, 0x20);
+	Mcp23017 mcp1(i2c_dev, 0x21);
+	Mcp23017 elsewhere(other_dev, 0x22);
+	Mcp23017_bus bus(i2c_dev);
+
+	REQUIRE(bus.add_device(mcp0) == 0);
+	REQUIRE(bus.add_device(mcp1) == 1);
+	REQUIRE(bus.add_device(elsewhere) == PICO_ERROR_GENERIC);
+
+	chip1.set_input_levels(0x0f0f);
+	REQUIRE(bus.poll_all() == PICO_ERROR_NONE);
+	REQUIRE(bus.get_snapshot()[1] == 0x0f0f);
+	REQUIRE(i2c_dev.combined == std::vector<uint32_t>{2, 2});
+}
+
+#endif //__linux__
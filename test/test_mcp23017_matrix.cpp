@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "mcp23017.h"
+#include "mcp23017_matrix.h"
+#include "mcp23017_private.h"
+#include "mcp23017_simulator.h"
+
+static i2c_inst_t matrix_i2c{};
+static uint64_t keys_down;
+
+/**
+ * Keys without diodes, a key joins its row and column so a low row pulls down every column it is joined to,
+ * directly or through other keys
+ */
+static uint16_t keypad(uint16_t levels, uint16_t outputs, void *) {
+	auto low_rows = static_cast<uint8_t>(~levels & outputs & 0xff);
+	uint8_t low_columns = 0;
+	bool spreading = true;
+	while (spreading) {
+		spreading = false;
+		for (int key = 0; key < 64; key++) {
+			if (((keys_down >> key) & 1) == 0) {
+				continue;
+			}
+			uint8_t row = 1 << (key / 8);
+			uint8_t column = 1 << (key % 8);
+			if ((low_rows & row) && !(low_columns & column)) {
+				low_columns |= column;
+				spreading = true;
+			}
+			if ((low_columns & column) && !(low_rows & row)) {
+				low_rows |= row;
+				spreading = true;
+			}
+		}
+	}
+	return static_cast<uint16_t>(~(low_columns << 8));
+}
+
+static void press(int row, int column, bool down) {
+	uint64_t bit = 1ull << mcp23017_key(row, column);
+	keys_down = down ? keys_down | bit : keys_down & ~bit;
+}
+
+TEST_CASE("Matrix Setup", "[mcp23017_matrix]") {
+	reset_for_test(&matrix_i2c);
+	Mcp23017_simulator chip(&matrix_i2c, 0x20);
+	Mcp23017 mcp_matrix(&matrix_i2c, 0x20);
+	Mcp23017_matrix matrix(mcp_matrix, 4, 3);
+
+	REQUIRE(matrix.setup() == PICO_ERROR_NONE);
+	REQUIRE(chip.peek_pair(MCP23017_IODIRA) == 0xfff0);
+	REQUIRE(chip.peek_pair(MCP23017_GPPUA) == 0x0700);
+	REQUIRE((chip.peek(MCP23017_OLATA) & 0x0f) == 0x0f);
+}
+
+TEST_CASE("Matrix Keeps Spare Port A Outputs", "[mcp23017_matrix]") {
+	reset_for_test(&matrix_i2c);
+	keys_down = 0;
+	Mcp23017_simulator chip(&matrix_i2c, 0x20);
+	chip.set_input_model(keypad, nullptr);
+	Mcp23017 mcp_matrix(&matrix_i2c, 0x20);
+	Mcp23017_matrix matrix(mcp_matrix, 4, 3);
+	REQUIRE(matrix.setup() == PICO_ERROR_NONE);
+	REQUIRE(mcp_matrix.set_io_direction(0xffb0) == PICO_ERROR_NONE); //GPA6 as an output
+	mcp_matrix.set_bits(0x0040);
+	REQUIRE(mcp_matrix.flush_output() == PICO_ERROR_NONE);
+	mock_time_us = 500;
+
+	REQUIRE(matrix.scan() == 0);
+	std::vector<uint16_t> log;
+	chip.set_output_log(&log);
+	press(1, 2, true);
+	REQUIRE(matrix.scan() == 1);
+	REQUIRE(log.size() == 4);
+	for (uint16_t latch : log) {
+		REQUIRE((latch & 0x0040) != 0);
+	}
+	REQUIRE((chip.peek(MCP23017_OLATA) & 0x40) != 0);
+	REQUIRE((mcp_matrix.get_output_bits() & 0x0040) != 0);
+	chip.set_output_log(nullptr);
+}
+
+TEST_CASE("Matrix Key Events", "[mcp23017_matrix]") {
+	reset_for_test(&matrix_i2c);
+	keys_down = 0;
+	Mcp23017_simulator chip(&matrix_i2c, 0x20);
+	chip.set_input_model(keypad, nullptr);
+	Mcp23017 mcp_matrix(&matrix_i2c, 0x20);
+	Mcp23017_matrix matrix(mcp_matrix);
+	REQUIRE(matrix.setup() == PICO_ERROR_NONE);
+	mock_time_us = 500;
+
+	REQUIRE(matrix.scan() == 0);
+	press(2, 5, true);
+	press(7, 0, true);
+	REQUIRE(matrix.scan() == 2);
+	REQUIRE(matrix.is_pressed(mcp23017_key(2, 5)));
+	REQUIRE(matrix.get_keys() == ((1ull << mcp23017_key(2, 5)) | (1ull << mcp23017_key(7, 0))));
+
+	Mcp23017_key_event event{};
+	REQUIRE(matrix.pop_event(event));
+	REQUIRE(event.key == mcp23017_key(2, 5));
+	REQUIRE(event.pressed);
+	REQUIRE(event.timestamp_us == 500);
+	REQUIRE(matrix.pop_event(event));
+	REQUIRE(event.key == mcp23017_key(7, 0));
+
+	press(2, 5, false);
+	REQUIRE(matrix.scan() == 1);
+	REQUIRE(matrix.pop_event(event));
+	REQUIRE(event.key == mcp23017_key(2, 5));
+	REQUIRE_FALSE(event.pressed);
+	REQUIRE_FALSE(matrix.pop_event(event));
+}
+
+TEST_CASE("Matrix Scan Bus Cost", "[mcp23017_matrix]") {
+	reset_for_test(&matrix_i2c);
+	keys_down = 0;
+	Mcp23017_simulator chip(&matrix_i2c, 0x20);
+	chip.set_input_model(keypad, nullptr);
+	Mcp23017 mcp_matrix(&matrix_i2c, 0x20);
+	Mcp23017_matrix matrix(mcp_matrix);
+	REQUIRE(matrix.setup() == PICO_ERROR_NONE);
+
+	reset_bus_stats();
+	REQUIRE(matrix.scan() == 0);
+
+	//a write and a read per row, all in one bus hold, well inside 1ms at 400 kHz
+	REQUIRE(mock_bus_stats.transactions == 16);
+	REQUIRE(mock_bus_stats.bytes == 8 * 3);
+	REQUIRE(mock_bus_stats.repeated_starts == 15);
+	REQUIRE(mock_bus_stats.stops == 1);
+	REQUIRE(mock_bus_time_us(400000) < 1000.0);
+
+	//the scan leaves the last row driven, a flush of the output state doesn't undo it
+	reset_bus_stats();
+	REQUIRE(mcp_matrix.flush_output() == PICO_ERROR_NONE);
+	REQUIRE(mock_bus_stats.transactions == 0);
+}
+
+TEST_CASE("Matrix Ghosting", "[mcp23017_matrix]") {
+	reset_for_test(&matrix_i2c);
+	keys_down = 0;
+	Mcp23017_simulator chip(&matrix_i2c, 0x20);
+	chip.set_input_model(keypad, nullptr);
+	Mcp23017 mcp_matrix(&matrix_i2c, 0x20);
+	Mcp23017_matrix matrix(mcp_matrix);
+	REQUIRE(matrix.setup() == PICO_ERROR_NONE);
+	REQUIRE(matrix.scan() == 0);
+
+	press(0, 0, true);
+	press(0, 1, true);
+	REQUIRE(matrix.scan() == 2);
+	press(1, 0, true);
+	REQUIRE(matrix.scan() == 0);
+	REQUIRE(matrix.is_ghosted());
+	REQUIRE(matrix.get_ghost_count() == 1);
+	REQUIRE(((matrix.get_raw_keys() >> mcp23017_key(1, 1)) & 1) == 1); //the phantom
+	REQUIRE_FALSE(matrix.is_pressed(mcp23017_key(1, 0)));
+
+	press(0, 1, false);
+	REQUIRE(matrix.scan() == 2);
+	REQUIRE_FALSE(matrix.is_ghosted());
+	REQUIRE(matrix.is_pressed(mcp23017_key(1, 0)));
+	REQUIRE_FALSE(matrix.is_pressed(mcp23017_key(1, 1)));
+}
+
+TEST_CASE("Matrix Debounce And Failure", "[mcp23017_matrix]") {
+	reset_for_test(&matrix_i2c);
+	keys_down = 0;
+	Mcp23017_simulator chip(&matrix_i2c, 0x20);
+	chip.set_input_model(keypad, nullptr);
+	Mcp23017 mcp_matrix(&matrix_i2c, 0x20);
+	Mcp23017_matrix matrix(mcp_matrix);
+	REQUIRE(matrix.setup() == PICO_ERROR_NONE);
+	matrix.set_debounce_depth(3);
+	REQUIRE(matrix.scan() == 0);
+
+	press(4, 4, true);
+	REQUIRE(matrix.scan() == 0);
+	REQUIRE(matrix.scan() == 0);
+	REQUIRE(matrix.scan() == 1);
+
+	mock_queue_i2c_result(PICO_ERROR_TIMEOUT, 1);
+	REQUIRE(matrix.scan() == MCP23017_ERROR_TIMEOUT);
+	REQUIRE(matrix.is_pressed(mcp23017_key(4, 4)));
+}
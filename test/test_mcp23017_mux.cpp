@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "mcp23017.h"
+#include "mcp23017_mux.h"
+#include "mcp23017_private.h"
+#include "mcp23017_simulator.h"
+
+/**
+ * Model of a TCA9548A, its control register write connects a channel, everything else goes to the simulators on the
+ * connected channel through the mocked i2c calls
+ */
+class Tca9548a_model : public Mcp23017_transport {
+public:
+	i2c_inst_t channel_i2c[MCP23017_MUX_CHANNELS]{};
+	uint8_t control{};
+	int control_writes{};
+	bool fail_next_control{};
+
+	int write(uint8_t address, const uint8_t *src, size_t length, bool nostop, uint32_t timeout_us) override {
+		if (address == MCP23017_MUX_DEFAULT_ADDRESS) {
+			control_writes++;
+			if (fail_next_control) {
+				fail_next_control = false;
+				return MCP23017_ERROR_NACK;
+			}
+			control = src[length - 1];
+			return static_cast<int>(length);
+		}
+		i2c_inst_t *i2c = connected();
+		return i2c ? i2c_write_timeout_us(i2c, address, src, length, nostop, timeout_us) : MCP23017_ERROR_NACK;
+	}
+
+	int read(uint8_t address, uint8_t *dst, size_t length, bool nostop, uint32_t timeout_us) override {
+		i2c_inst_t *i2c = connected();
+		return i2c ? i2c_read_timeout_us(i2c, address, dst, length, nostop, timeout_us) : MCP23017_ERROR_NACK;
+	}
+
+private:
+	i2c_inst_t *connected() {
+		if (control == 0 || (control & (control - 1)) != 0) {
+			return nullptr; //one channel at a time in this model
+		}
+		return &channel_i2c[__builtin_ctz(control)];
+	}
+};
+
+TEST_CASE("Mux Same Address On Two Channels", "[mcp23017_mux]") {
+	Tca9548a_model tca;
+	reset_for_test(&tca.channel_i2c[0]);
+	Mcp23017_simulator chip0(&tca.channel_i2c[0], 0x20);
+	Mcp23017_simulator chip3(&tca.channel_i2c[3], 0x20);
+	Mcp23017_mux mux(tca);
+	Mcp23017 mcp0(mux.get_channel(0), 0x20);
+	Mcp23017 mcp3(mux.get_channel(3), 0x20);
+	REQUIRE(mux.get_selected_channel() == MCP23017_MUX_UNKNOWN_CHANNEL);
+
+	REQUIRE(mcp0.set_io_direction(0x0000) == PICO_ERROR_NONE);
+	REQUIRE(tca.control == 0x01);
+	REQUIRE(mcp0.set_all_output_bits(0x1234) == PICO_ERROR_NONE);
+	REQUIRE(tca.control_writes == 1); //already selected
+
+	REQUIRE(mcp3.set_io_direction(0x0000) == PICO_ERROR_NONE);
+	REQUIRE(mcp3.set_all_output_bits(0xabcd) == PICO_ERROR_NONE);
+	REQUIRE(tca.control == 0x08);
+	REQUIRE(tca.control_writes == 2);
+	REQUIRE(mux.get_select_count() == 2);
+	REQUIRE(mux.get_selected_channel() == 3);
+
+	REQUIRE(chip0.peek_pair(MCP23017_OLATA) == 0x1234);
+	REQUIRE(chip3.peek_pair(MCP23017_OLATA) == 0xabcd);
+
+	REQUIRE(mux.select(MCP23017_MUX_NO_CHANNEL) == PICO_ERROR_NONE);
+	REQUIRE(tca.control == 0x00);
+}
+
+TEST_CASE("Mux Poll Grouped By Channel", "[mcp23017_mux]") {
+	Tca9548a_model tca;
+	reset_for_test(&tca.channel_i2c[0]);
+	Mcp23017_mux mux(tca);
+	Mcp23017_simulator chip1a(&tca.channel_i2c[1], 0x20);
+	Mcp23017_simulator chip1b(&tca.channel_i2c[1], 0x21);
+	Mcp23017_simulator chip5a(&tca.channel_i2c[5], 0x20);
+	Mcp23017_simulator chip5b(&tca.channel_i2c[5], 0x21);
+	Mcp23017_simulator chip6(&tca.channel_i2c[6], 0x27);
+	Mcp23017 mcp1a(mux.get_channel(1), 0x20);
+	Mcp23017 mcp1b(mux.get_channel(1), 0x21);
+	Mcp23017 mcp5a(mux.get_channel(5), 0x20);
+	Mcp23017 mcp5b(mux.get_channel(5), 0x21);
+	Mcp23017 mcp6(mux.get_channel(6), 0x27);
+
+	//added with the channels interleaved
+	REQUIRE(mux.add_device(mcp5a) == 0);
+	REQUIRE(mux.add_device(mcp1a) == 1);
+	REQUIRE(mux.add_device(mcp6) == 2);
+	REQUIRE(mux.add_device(mcp5b) == 3);
+	REQUIRE(mux.add_device(mcp1b) == 4);
+	chip1b.set_input_levels(0x0102);
+	chip5a.set_input_levels(0x0506);
+	chip6.set_input_levels(0x0607);
+
+	reset_bus_stats();
+	REQUIRE(mux.poll_all() == PICO_ERROR_NONE);
+	REQUIRE(mux.get_select_count() == 3); //one per channel in use
+	REQUIRE(mcp1b.get_last_input_pin_values() == 0x0102);
+	REQUIRE(mcp5a.get_last_input_pin_values() == 0x0506);
+	REQUIRE(mcp6.get_last_input_pin_values() == 0x0607);
+	REQUIRE(mock_bus_stats.stops == 3); //the devices on a channel are read back to back
+
+	//the next pass starts on the channel left selected
+	REQUIRE(mux.poll_all() == PICO_ERROR_NONE);
+	REQUIRE(mux.get_select_count() == 3 + 2);
+
+	//only channels with a changed device are selected to flush
+	REQUIRE(mux.flush_all() == PICO_ERROR_NONE);
+	uint32_t selects = mux.get_select_count();
+	mcp5b.set_bits(0x0001);
+	REQUIRE(mux.flush_all() == PICO_ERROR_NONE);
+	REQUIRE(mux.get_select_count() == selects + 1);
+	REQUIRE(chip5b.peek(MCP23017_OLATA) == 0x01);
+	REQUIRE(mux.flush_all() == PICO_ERROR_NONE);
+	REQUIRE(mux.get_select_count() == selects + 1);
+}
+
+TEST_CASE("Mux Devices And Failures", "[mcp23017_mux]") {
+	Tca9548a_model tca;
+	reset_for_test(&tca.channel_i2c[0]);
+	Mcp23017_simulator chip(&tca.channel_i2c[2], 0x20);
+	Mcp23017_mux mux(tca);
+	Mcp23017_mux other_mux(tca, 0x71);
+	Mcp23017 mcp(mux.get_channel(2), 0x20);
+	Mcp23017 same_address(mux.get_channel(2), 0x20);
+	Mcp23017 other_channel(mux.get_channel(4), 0x20);
+	Mcp23017 elsewhere(other_mux.get_channel(2), 0x20);
+
+	REQUIRE(mux.add_device(mcp) == 0);
+	REQUIRE(mux.add_device(same_address) == PICO_ERROR_GENERIC);
+	REQUIRE(mux.add_device(other_channel) == 1);
+	REQUIRE(mux.add_device(elsewhere) == PICO_ERROR_GENERIC);
+	REQUIRE(mux.get_channel(12).get_channel() == 7);
+
+	tca.fail_next_control = true;
+	REQUIRE(mcp.update_and_get_input_values() == MCP23017_ERROR_NACK);
+	REQUIRE(mux.get_selected_channel() == MCP23017_MUX_UNKNOWN_CHANNEL);
+	REQUIRE(mcp.update_and_get_input_values() == PICO_ERROR_NONE);
+	REQUIRE(mux.get_selected_channel() == 2);
+
+	//after a mux reset the channel is selected again
+	int writes = tca.control_writes;
+	tca.control = 0;
+	mux.invalidate_selection();
+	REQUIRE(mcp.update_and_get_input_values() == PICO_ERROR_NONE);
+	REQUIRE(tca.control_writes == writes + 1);
+
+	writes = tca.control_writes;
+	REQUIRE(mux.select(MCP23017_MUX_UNKNOWN_CHANNEL) == PICO_ERROR_GENERIC);
+	REQUIRE(mux.select(MCP23017_MUX_CHANNELS) == PICO_ERROR_GENERIC);
+	REQUIRE(tca.control_writes == writes);
+	REQUIRE(mux.get_selected_channel() == 2);
+
+	//the device's own error is passed on
+	mcp.set_bits(0x0001);
+	mock_queue_i2c_result(PICO_ERROR_TIMEOUT, 1);
+	REQUIRE(mux.flush_all() == MCP23017_ERROR_TIMEOUT);
+	REQUIRE(mux.flush_all() == PICO_ERROR_NONE);
+	REQUIRE(chip.peek(MCP23017_OLATA) == 0x01);
+}
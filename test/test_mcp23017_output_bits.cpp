@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <thread>
+
+#include "mcp23017.h"
+#include "mcp23017_private.h"
+#include "mcp23017_simulator.h"
+
+static i2c_inst_t bits_i2c{};
+static Mcp23017 *other_core_mcp;
+static uint32_t other_core_transactions;
+static int other_core_result;
+
+static void other_core_flush() {
+	uint32_t before = mock_bus_stats.transactions;
+	other_core_mcp->set_bits(0x0100);
+	other_core_result = other_core_mcp->flush_output();
+	other_core_transactions = mock_bus_stats.transactions - before;
+}
+
+TEST_CASE("Set Clear Toggle Bits", "[mcp23017_output_bits]") {
+	reset_for_test(&bits_i2c);
+	Mcp23017 mcp_bits(&bits_i2c, 0x20);
+
+	mcp_bits.set_bits(0x00f0);
+	REQUIRE(mcp_bits.get_output_bits() == 0x00f0);
+	mcp_bits.clear_bits(0x0030);
+	REQUIRE(mcp_bits.get_output_bits() == 0x00c0);
+	mcp_bits.toggle_bits(0x81c0);
+	REQUIRE(mcp_bits.get_output_bits() == 0x8100);
+	mcp_bits.set_output_bit_for_pin(0, true);
+	mcp_bits.set_output_bit_for_pin(15, false);
+	REQUIRE(mcp_bits.get_output_bits() == 0x0101);
+	REQUIRE(mcp_bits.get_output_bit_for_pin(8));
+	mcp_bits.set_output_bit_for_pin(16, true);
+	mcp_bits.set_output_bit_for_pin(-1, true);
+	mcp_bits.set_output_bit_for_pin(40, false);
+	REQUIRE(mcp_bits.get_output_bits() == 0x0101);
+	REQUIRE(!mcp_bits.get_output_bit_for_pin(16));
+}
+
+TEST_CASE("Flush During Flush Is Merged", "[mcp23017_output_bits]") {
+	reset_for_test(&bits_i2c);
+	Mcp23017_simulator chip(&bits_i2c, 0x20);
+	Mcp23017 mcp_bits(&bits_i2c, 0x20);
+	mcp_bits.set_all_output_bits(0x0000);
+
+	other_core_mcp = &mcp_bits;
+	mock_transfer_hook = other_core_flush;
+	reset_bus_stats();
+	mcp_bits.set_bits(0x0001);
+	REQUIRE(mcp_bits.flush_output() == PICO_ERROR_NONE);
+
+	//the other core's flush returned without using the bus, its change was written by the flush in progress
+	REQUIRE(other_core_result == PICO_ERROR_NONE);
+	REQUIRE(other_core_transactions == 0);
+	REQUIRE(mock_bus_stats.transactions == 2);
+	REQUIRE(chip.peek_pair(MCP23017_OLATA) == 0x0101);
+}
+
+TEST_CASE("Both Cores Changing Outputs", "[mcp23017_output_bits]") {
+	reset_for_test(&bits_i2c);
+	Mcp23017_simulator chip(&bits_i2c, 0x20);
+	Mcp23017 mcp_bits(&bits_i2c, 0x20);
+	mcp_bits.set_all_output_bits(0x0000);
+	const int toggles = 2000;
+
+	//an even number of toggles leaves the low byte off, an odd number leaves the high byte on, any lost update shows
+	std::thread core1([&mcp_bits] {
+		for (int i = 0; i < toggles; i++) {
+			mcp_bits.toggle_bits(0x00ff);
+			mcp_bits.flush_output();
+		}
+	});
+	for (int i = 0; i < toggles + 1; i++) {
+		mcp_bits.toggle_bits(0xff00);
+		mcp_bits.flush_output();
+	}
+	core1.join();
+
+	REQUIRE(mcp_bits.get_output_bits() == 0xff00);
+	REQUIRE(chip.peek_pair(MCP23017_OLATA) == 0xff00);
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "mcp23017.h"
+#include "mcp23017_pin.h"
+#include "mcp23017_private.h"
+#include "mcp23017_simulator.h"
+
+static i2c_inst_t pin_i2c{};
+
+typedef Mcp23017_pin_group<3, 5, 6, 7> Digit_pins;
+
+static_assert(Mcp23017_pin<0>::mask == 0x0001);
+static_assert(Mcp23017_pin<15>::mask == 0x8000);
+static_assert(Digit_pins::mask == 0x00e8);
+static_assert(Digit_pins::size == 4);
+static_assert(Digit_pins::unpack(0x9) == 0x0088);
+static_assert(Digit_pins::pack(0xffff) == 0xf);
+static_assert(Mcp23017_pin_group<15, 0>::unpack(0x1) == 0x8000);
+static_assert(mcp23017_pin_mask(9) == 0x0200);
+static_assert(mcp23017_pin_mask(16) == 0);
+static_assert(mcp23017_pin_mask(-1) == 0);
+
+TEST_CASE("Pin Handles", "[mcp23017_pin]") {
+	reset_for_test(&pin_i2c);
+	Mcp23017_simulator chip(&pin_i2c, 0x20);
+	Mcp23017 mcp_pin(&pin_i2c, 0x20);
+	mcp_pin.set_io_direction(0x00ff);
+	Mcp23017_pin<9> pump(mcp_pin);
+	Mcp23017_pin<2> button(mcp_pin);
+
+	pump.set(true);
+	REQUIRE(pump.get_output());
+	REQUIRE(mcp_pin.get_output_bits() == 0x0200);
+	pump.toggle();
+	REQUIRE_FALSE(pump.get_output());
+	pump.set(true);
+	REQUIRE(mcp_pin.flush_output() == PICO_ERROR_NONE);
+	REQUIRE(chip.peek_pair(MCP23017_OLATA) == 0x0200);
+
+	chip.set_input_levels(0x0004);
+	mcp_pin.update_and_get_input_values();
+	REQUIRE(button.get_input());
+	REQUIRE(button.get_debounced_input());
+	REQUIRE(&button.get_device() == &mcp_pin);
+}
+
+TEST_CASE("Single Core Output Access", "[mcp23017_pin]") {
+	reset_for_test(&pin_i2c);
+	Mcp23017_simulator chip(&pin_i2c, 0x20);
+	Mcp23017 mcp_pin(&pin_i2c, 0x20);
+
+	mcp_pin.write_bits_unlocked(0x00ff, 0x0f5a);
+	REQUIRE(mcp_pin.get_output_bits_unlocked() == 0x005a);
+	mcp_pin.toggle_bits_unlocked(0x8001);
+	REQUIRE(mcp_pin.get_output_bits() == 0x805b);
+	mcp_pin.set_bits(0x0100);
+	REQUIRE(mcp_pin.get_output_bits_unlocked() == 0x815b);
+	REQUIRE(mcp_pin.flush_output() == PICO_ERROR_NONE);
+	REQUIRE(chip.peek_pair(MCP23017_OLATA) == 0x815b);
+}
+
+TEST_CASE("Pin Groups", "[mcp23017_pin]") {
+	reset_for_test(&pin_i2c);
+	Mcp23017_simulator chip(&pin_i2c, 0x20);
+	Mcp23017 mcp_pin(&pin_i2c, 0x20);
+	mcp_pin.set_io_direction(0xff00);
+	Digit_pins digit(mcp_pin);
+	Mcp23017_pin_group<8, 9, 10, 11> switches(mcp_pin);
+
+	mcp_pin.set_bits(0x0001);
+	digit.write_packed(9);
+	REQUIRE(digit.get_output() == 0x0088);
+	REQUIRE(mcp_pin.get_output_bits() == 0x0089);
+	digit.write(0xffff);
+	REQUIRE(mcp_pin.get_output_bits() == 0x00e9);
+	digit.toggle_all();
+	REQUIRE(mcp_pin.get_output_bits() == 0x0001);
+	digit.set_all();
+	digit.clear_all();
+	REQUIRE(mcp_pin.get_output_bits() == 0x0001);
+	digit.write_packed(0x6);
+	mcp_pin.flush_output();
+	REQUIRE(chip.peek(MCP23017_OLATA) == 0x61);
+
+	chip.set_input_levels(0x0a00);
+	mcp_pin.update_and_get_input_values();
+	REQUIRE(switches.get_input() == 0x0a00);
+	REQUIRE(switches.get_input_packed() == 0xa);
+	REQUIRE(switches.get_debounced_input() == 0x0a00);
+}
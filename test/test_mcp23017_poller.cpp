@@ -0,0 +1,146 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "mcp23017.h"
+#include "mcp23017_poller.h"
+#include "mcp23017_simulator.h"
+
+static i2c_inst_t poller_i2c{};
+
+static const uint32_t MIN_PERIOD_US = 1000;
+static const uint32_t MAX_PERIOD_US = 64000;
+
+struct Poll_log {
+	int calls;
+	uint16_t changed;
+	Mcp23017 *mcp;
+};
+
+static void log_change(Mcp23017 &mcp, uint16_t changed, void *context) {
+	auto log = static_cast<Poll_log *>(context);
+	log->calls++;
+	log->changed = changed;
+	log->mcp = &mcp;
+}
+
+static void run_until(Mcp23017_poller &poller, uint64_t end_us) {
+	while (poller.get_next_poll_us() <= end_us) {
+		mock_time_us = poller.get_next_poll_us();
+		poller.poll(mock_time_us);
+	}
+}
+
+TEST_CASE("Poller Backs Off When Quiet", "[mcp23017_poller]") {
+	reset_for_test(&poller_i2c);
+	Mcp23017_simulator chip(&poller_i2c, 0x20);
+	Mcp23017 mcp_poller(&poller_i2c, 0x20);
+	Mcp23017_poller poller(MIN_PERIOD_US, MAX_PERIOD_US);
+	REQUIRE(poller.add_device(mcp_poller) == 0);
+
+	REQUIRE(poller.poll(0) == 0);
+	REQUIRE(poller.get_period_us(0) == 2 * MIN_PERIOD_US);
+	REQUIRE(poller.get_next_poll_us() == 2 * MIN_PERIOD_US);
+	REQUIRE(poller.poll(MIN_PERIOD_US) == 0);
+	REQUIRE(poller.get_poll_count() == 1);
+
+	run_until(poller, 1000000);
+	REQUIRE(poller.get_period_us(0) == MAX_PERIOD_US);
+	//a fixed poll at the minimum period would have made 1001 reads
+	REQUIRE(poller.get_poll_count() < 25);
+}
+
+TEST_CASE("Poller Speeds Up On Activity", "[mcp23017_poller]") {
+	reset_for_test(&poller_i2c);
+	Mcp23017_simulator chip(&poller_i2c, 0x20);
+	Mcp23017 mcp_poller(&poller_i2c, 0x20);
+	Mcp23017_poller poller(MIN_PERIOD_US, MAX_PERIOD_US);
+	Poll_log log{};
+	poller.set_handler(log_change, &log);
+	poller.add_device(mcp_poller);
+
+	run_until(poller, 500000);
+	REQUIRE(poller.get_period_us(0) == MAX_PERIOD_US);
+	REQUIRE(log.calls == 0);
+
+	chip.set_input_levels(0x0004);
+	mock_time_us = poller.get_next_poll_us();
+	REQUIRE(poller.poll(mock_time_us) == 1);
+	REQUIRE(log.calls == 1);
+	REQUIRE(log.changed == 0x0004);
+	REQUIRE(log.mcp == &mcp_poller);
+	REQUIRE(poller.get_period_us(0) == MIN_PERIOD_US);
+
+	//a burst of changes each minimum period is followed without missing any
+	for (int i = 0; i < 10; i++) {
+		chip.set_input_levels(i & 1 ? 0x0004 : 0x0000);
+		mock_time_us = poller.get_next_poll_us();
+		REQUIRE(poller.poll(mock_time_us) == 1);
+		REQUIRE(poller.get_period_us(0) == MIN_PERIOD_US);
+	}
+	REQUIRE(log.calls == 11);
+
+	mock_time_us = poller.get_next_poll_us();
+	REQUIRE(poller.poll(mock_time_us) == 0);
+	REQUIRE(poller.get_period_us(0) == 2 * MIN_PERIOD_US);
+}
+
+TEST_CASE("Poller Latency Targets Per Device", "[mcp23017_poller]") {
+	reset_for_test(&poller_i2c);
+	Mcp23017_simulator chip0(&poller_i2c, 0x20);
+	Mcp23017_simulator chip1(&poller_i2c, 0x21);
+	Mcp23017 mcp0(&poller_i2c, 0x20);
+	Mcp23017 mcp1(&poller_i2c, 0x21);
+	Mcp23017_poller poller(MIN_PERIOD_US, MAX_PERIOD_US);
+	REQUIRE(poller.add_device(mcp0) == 0);
+	REQUIRE(poller.add_device(mcp1, 5000) == 1);
+
+	run_until(poller, 1000000);
+	REQUIRE(poller.get_period_us(0) == MAX_PERIOD_US);
+	REQUIRE(poller.get_period_us(1) == 5000);
+
+	//changes on one device don't speed up the other
+	chip0.set_input_levels(0x8000);
+	run_until(poller, mock_time_us + MAX_PERIOD_US);
+	REQUIRE(mcp0.get_last_input_pin_values() == 0x8000);
+	REQUIRE(poller.get_period_us(1) == 5000);
+}
+
+TEST_CASE("Poller Reports Read Failures", "[mcp23017_poller]") {
+	reset_for_test(&poller_i2c);
+	Mcp23017_simulator chip(&poller_i2c, 0x20);
+	Mcp23017 mcp_poller(&poller_i2c, 0x20);
+	Mcp23017_poller poller(MIN_PERIOD_US, MAX_PERIOD_US);
+	poller.add_device(mcp_poller);
+
+	mock_queue_i2c_result(PICO_ERROR_GENERIC, 1);
+	REQUIRE(poller.poll(0) == PICO_ERROR_GENERIC);
+	REQUIRE(poller.get_next_poll_us() == MIN_PERIOD_US);
+	REQUIRE(poller.poll(MIN_PERIOD_US) == 0);
+}
+
+TEST_CASE("Poller Timer", "[mcp23017_poller]") {
+	reset_for_test(&poller_i2c);
+	Mcp23017_simulator chip(&poller_i2c, 0x20);
+	Mcp23017 mcp_poller(&poller_i2c, 0x20);
+	Mcp23017_poller poller(MIN_PERIOD_US, MAX_PERIOD_US);
+	poller.add_device(mcp_poller);
+
+	REQUIRE(poller.start(MIN_PERIOD_US));
+	REQUIRE_FALSE(poller.start(MIN_PERIOD_US));
+	REQUIRE(poller.service() == 0);
+	reset_bus_stats();
+	mock_run_timers();
+	REQUIRE(mock_bus_stats.transactions == 0); //the timer only marks the poll due
+	REQUIRE(poller.get_poll_count() == 0);
+	REQUIRE(poller.service() == 0);
+	REQUIRE(poller.get_poll_count() == 1);
+	REQUIRE(poller.service() == 0);
+	REQUIRE(poller.get_poll_count() == 1);
+	poller.stop();
+	REQUIRE(mock_run_timers() == 0);
+}
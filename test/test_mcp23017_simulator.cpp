@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "mcp23017.h"
+#include "mcp23017_bus.h"
+#include "mcp23017_private.h"
+#include "mcp23017_t.h"
+#include "mcp23017_simulator.h"
+
+static i2c_inst_t sim_i2c{};
+
+TEST_CASE("Simulator Apply Config And Outputs", "[mcp23017_simulator]") {
+	reset_for_test(&sim_i2c);
+	Mcp23017_simulator chip(&sim_i2c, 0x20);
+	Mcp23017 mcp_sim(&sim_i2c, 0x20);
+	Mcp23017_config config;
+	config.io_direction = 0xff00;
+	config.pullup = 0xff00;
+	config.mirroring = true;
+
+	REQUIRE(mcp_sim.apply(config) == PICO_ERROR_NONE);
+	REQUIRE(chip.peek_pair(MCP23017_IODIRA) == 0xff00);
+	REQUIRE(chip.peek_pair(MCP23017_GPPUA) == 0xff00);
+	REQUIRE(chip.peek(MCP23017_IOCONB) == 1 << MCP23017_IOCON_MIRROR_BIT);
+
+	mcp_sim.set_output_bit_for_pin(3, true);
+	mcp_sim.set_output_bit_for_pin(12, true); //an input pin, latched but not driven
+	REQUIRE(mcp_sim.flush_output() == PICO_ERROR_NONE);
+	REQUIRE(chip.peek_pair(MCP23017_OLATA) == 0x1008);
+	REQUIRE((chip.get_pin_levels() & 0x00ff) == 0x08);
+
+	chip.set_input_levels(0x0200);
+	REQUIRE(mcp_sim.update_and_get_input_values() == PICO_ERROR_NONE);
+	REQUIRE(mcp_sim.get_last_input_pin_values() == 0x0208); //GPIO reads back the output latch on output pins
+}
+
+TEST_CASE("Simulator Interrupt Capture Clears On Read", "[mcp23017_simulator]") {
+	reset_for_test(&sim_i2c);
+	Mcp23017_simulator chip(&sim_i2c, 0x21);
+	Mcp23017 mcp_sim(&sim_i2c, 0x21);
+	Mcp23017_config config;
+	config.interrupt_enable = 0xffff;
+	config.mirroring = true;
+	REQUIRE(mcp_sim.apply(config) == PICO_ERROR_NONE);
+
+	chip.set_input_levels(0x0100);
+	chip.set_input_levels(0x0300); //a second change on the port while the first is pending isn't captured
+	REQUIRE(chip.is_interrupt_asserted(0));
+	REQUIRE(chip.is_interrupt_asserted(1));
+
+	Mcp23017_interrupt_state state{};
+	REQUIRE(mcp_sim.service_interrupt(state) == PICO_ERROR_NONE);
+	REQUIRE(state.flags == 0x0100);
+	REQUIRE(state.captured == 0x0100);
+	REQUIRE(state.inputs == 0x0300);
+	REQUIRE(!chip.is_interrupt_asserted(0));
+	REQUIRE(!chip.is_interrupt_asserted(1));
+}
+
+TEST_CASE("Simulator Compare To Default Value", "[mcp23017_simulator]") {
+	reset_for_test(&sim_i2c);
+	Mcp23017_simulator chip(&sim_i2c, 0x22);
+	Mcp23017 mcp_sim(&sim_i2c, 0x22);
+	Mcp23017_config config;
+	config.interrupt_enable = 0x0001;
+	config.interrupt_control = 0x0001;
+	config.default_value = 0x0001;
+	REQUIRE(mcp_sim.apply(config) == PICO_ERROR_NONE);
+	REQUIRE(chip.is_interrupt_asserted(0)); //pin 0 is low, differing from DEFVAL
+
+	REQUIRE(mcp_sim.get_interrupt_values() == 0x0000);
+	REQUIRE(chip.is_interrupt_asserted(0)); //raised again while the condition holds
+
+	chip.set_input_levels(0x0001);
+	REQUIRE(mcp_sim.update_and_get_input_values() == PICO_ERROR_NONE);
+	REQUIRE(!chip.is_interrupt_asserted(0));
+}
+
+TEST_CASE("Simulator Byte Mode Toggles Within Pair", "[mcp23017_simulator]") {
+	reset_for_test(&sim_i2c);
+	Mcp23017_simulator chip(&sim_i2c, 0x23);
+	Mcp23017 mcp_sim(&sim_i2c, 0x23);
+	Mcp23017_config config;
+	config.io_direction = 0x0000;
+	config.sequential = false;
+	REQUIRE(mcp_sim.apply(config) == PICO_ERROR_NONE);
+	REQUIRE(chip.peek(MCP23017_IOCONA) == 1 << MCP23017_IOCON_SEQOP_BIT);
+
+	uint8_t stream[] = {MCP23017_OLATA, 0x01, 0x10, 0x02, 0x20};
+	i2c_write_blocking(&sim_i2c, 0x23, stream, sizeof(stream), false);
+	REQUIRE(chip.peek_pair(MCP23017_OLATA) == 0x2002);
+	REQUIRE(chip.peek_pair(MCP23017_IODIRA) == 0x0000);
+}
+
+TEST_CASE("Simulator Bank Separate Layout", "[mcp23017_simulator]") {
+	reset_for_test(&sim_i2c);
+	Mcp23017_simulator chip(&sim_i2c, 0x24);
+	Mcp23017T<0x24, Mcp23017_bank::separate> mcp_t(&sim_i2c);
+
+	REQUIRE(mcp_t.setup(false, false) == PICO_ERROR_NONE);
+	REQUIRE(mcp_t.set_io_direction<Mcp23017_port::b>(0x00) == PICO_ERROR_NONE);
+	mcp_t.set_output<8>(true);
+	REQUIRE(mcp_t.flush_port_output<Mcp23017_port::b>() == PICO_ERROR_NONE);
+	REQUIRE(chip.peek(MCP23017_IODIRB) == 0x00);
+	REQUIRE(chip.peek(MCP23017_IODIRA) == 0xff);
+	REQUIRE(chip.peek(MCP23017_OLATB) == 0x01);
+
+	chip.set_input_levels(0x0080);
+	REQUIRE(mcp_t.update_input_values() == PICO_ERROR_NONE);
+	REQUIRE(mcp_t.get_input_values() == 0x0180);
+}
+
+TEST_CASE("Simulator Multiple Devices And Bus Time", "[mcp23017_simulator]") {
+	reset_for_test(&sim_i2c);
+	Mcp23017_simulator chip0(&sim_i2c, 0x20);
+	Mcp23017_simulator chip1(&sim_i2c, 0x21);
+	Mcp23017 mcp0(&sim_i2c, 0x20);
+	Mcp23017 mcp1(&sim_i2c, 0x21);
+	Mcp23017_bus bus(&sim_i2c);
+	bus.add_device(mcp0);
+	bus.add_device(mcp1);
+	chip0.set_input_levels(0x1234);
+	chip1.set_input_levels(0x5678);
+
+	reset_bus_stats();
+	REQUIRE(bus.poll_all() == PICO_ERROR_NONE);
+	REQUIRE(bus.get_snapshot()[0] == 0x1234);
+	REQUIRE(bus.get_snapshot()[1] == 0x5678);
+	REQUIRE(mock_bus_stats.transactions == 4);
+	REQUIRE(mock_bus_stats.bytes == 6);
+	REQUIRE(mock_bus_stats.starts == 4);
+	REQUIRE(mock_bus_stats.repeated_starts == 3);
+	REQUIRE(mock_bus_stats.stops == 1);
+	REQUIRE(mock_bus_stats.bits == 4 + 9 * 10 + 1);
+	REQUIRE(mock_bus_time_us(100000) == 950.0);
+	REQUIRE(mock_bus_time_us(400000) == 237.5);
+}
@@ -0,0 +1,120 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "mcp23017.h"
+#include "mcp23017_bus.h"
+#include "mcp23017_simulator.h"
+
+static i2c_inst_t stats_i2c{};
+
+TEST_CASE("Stats Buckets", "[mcp23017_stats]") {
+	REQUIRE(mcp23017_stats_bucket(0) == 0);
+	REQUIRE(mcp23017_stats_bucket(1) == 1);
+	REQUIRE(mcp23017_stats_bucket(2) == 2);
+	REQUIRE(mcp23017_stats_bucket(3) == 2);
+	REQUIRE(mcp23017_stats_bucket(1000) == 10);
+	REQUIRE(mcp23017_stats_bucket(16383) == 14);
+	REQUIRE(mcp23017_stats_bucket(16384) == 15);
+	REQUIRE(mcp23017_stats_bucket(UINT32_MAX) == MCP23017_STATS_BUCKETS - 1);
+}
+
+#ifdef STATS_MCP23017
+
+static uint32_t total_operations(const Mcp23017_stats &stats, int operation) {
+	uint32_t total = 0;
+	for (auto count : stats.latency[operation]) {
+		total += count;
+	}
+	return total;
+}
+
+TEST_CASE("Stats Count Bus Activity", "[mcp23017_stats]") {
+	reset_for_test(&stats_i2c);
+	Mcp23017_simulator chip(&stats_i2c, 0x20);
+	Mcp23017 mcp_stats_device(&stats_i2c, 0x20);
+	Mcp23017_stats stats{};
+
+	mcp_stats_device.set_io_direction(0x0000);
+	mcp_stats_device.set_io_direction(0x0000);
+	mcp_stats_device.set_all_output_bits(0x00ff);
+	mcp_stats_device.flush_output();
+	mcp_stats_device.update_and_get_input_values();
+	Mcp23017_interrupt_state state{};
+	mcp_stats_device.service_interrupt(state);
+
+	REQUIRE(mcp_stats_device.get_stats(stats));
+	REQUIRE(stats.transactions == 6);
+	REQUIRE(stats.bytes == 3 + 3 + 1 + 2 + 1 + 6);
+	REQUIRE(stats.skipped_writes == 2);
+	REQUIRE(stats.errors == 0);
+	REQUIRE(stats.retries == 0);
+	REQUIRE(total_operations(stats, MCP23017_STATS_WRITE_CONFIG) == 1);
+	REQUIRE(total_operations(stats, MCP23017_STATS_WRITE_OUTPUT) == 1);
+	REQUIRE(total_operations(stats, MCP23017_STATS_READ_INPUT) == 1);
+	REQUIRE(total_operations(stats, MCP23017_STATS_READ_INTERRUPT) == 1);
+	REQUIRE(stats.latency[MCP23017_STATS_READ_INPUT][0] == 1);
+
+	mcp_stats_device.reset_stats();
+	REQUIRE(mcp_stats_device.get_stats(stats));
+	REQUIRE(stats.transactions == 0);
+	REQUIRE(total_operations(stats, MCP23017_STATS_READ_INPUT) == 0);
+}
+
+TEST_CASE("Stats Count Errors Retries And Latency", "[mcp23017_stats]") {
+	reset_for_test(&stats_i2c);
+	Mcp23017_simulator chip(&stats_i2c, 0x20);
+	Mcp23017 mcp_stats_device(&stats_i2c, 0x20);
+	Mcp23017_io_policy policy;
+	policy.timeout_us = 1000;
+	policy.retries = 1;
+	policy.backoff_us = 100;
+	mcp_stats_device.set_io_policy(policy);
+	Mcp23017_stats stats{};
+
+	mock_queue_i2c_result(PICO_ERROR_TIMEOUT, 1);
+	REQUIRE(mcp_stats_device.update_and_get_input_values() == PICO_ERROR_NONE);
+	mock_queue_i2c_result(PICO_ERROR_GENERIC, 2);
+	REQUIRE(mcp_stats_device.get_interrupt_values() == MCP23017_ERROR_NACK);
+
+	mcp_stats_device.get_stats(stats);
+	REQUIRE(stats.retries == 2);
+	REQUIRE(stats.errors == 1);
+	REQUIRE(stats.transactions == 5);
+	REQUIRE(stats.latency[MCP23017_STATS_READ_INPUT][mcp23017_stats_bucket(1100)] == 1);
+	REQUIRE(stats.latency[MCP23017_STATS_READ_INTERRUPT][mcp23017_stats_bucket(100)] == 1);
+}
+
+TEST_CASE("Stats Count Bus Polls", "[mcp23017_stats]") {
+	reset_for_test(&stats_i2c);
+	Mcp23017_simulator chip0(&stats_i2c, 0x20);
+	Mcp23017_simulator chip1(&stats_i2c, 0x21);
+	Mcp23017 mcp0(&stats_i2c, 0x20);
+	Mcp23017 mcp1(&stats_i2c, 0x21);
+	Mcp23017_bus bus(&stats_i2c);
+	bus.add_device(mcp0);
+	bus.add_device(mcp1);
+	Mcp23017_stats stats{};
+
+	bus.poll_all();
+	mcp1.get_stats(stats);
+	REQUIRE(stats.transactions == 2);
+	REQUIRE(stats.bytes == 3);
+	REQUIRE(total_operations(stats, MCP23017_STATS_READ_INPUT) == 1);
+}
+
+#else
+
+TEST_CASE("Stats Compiled Out", "[mcp23017_stats]") {
+	Mcp23017 mcp_stats_device(&stats_i2c, 0x20);
+	Mcp23017_stats stats{};
+	stats.transactions = 1;
+	REQUIRE_FALSE(mcp_stats_device.get_stats(stats));
+	REQUIRE(stats.transactions == 0);
+}
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+
+#include "mcp23017.h"
+#include "mcp23017_private.h"
+#include "mcp23017_simulator.h"
+
+static i2c_inst_t stream_i2c{};
+
+static std::vector<uint16_t> stream_words(size_t count) {
+	std::vector<uint16_t> words;
+	for (size_t i = 0; i < count; i++) {
+		words.push_back(static_cast<uint16_t>(0x0101 << (i % 8)) ^ static_cast<uint16_t>(i));
+	}
+	return words;
+}
+
+TEST_CASE("Stream Output Words In Order", "[mcp23017_stream]") {
+	reset_for_test(&stream_i2c);
+	Mcp23017_simulator chip(&stream_i2c, 0x20);
+	Mcp23017 mcp_stream(&stream_i2c, 0x20);
+	mcp_stream.set_io_direction(0x0000);
+	std::vector<uint16_t> log;
+	chip.set_output_log(&log);
+	std::vector<uint16_t> words = stream_words(3 * MCP23017_STREAM_CHUNK_WORDS + 4);
+
+	reset_bus_stats();
+	REQUIRE(mcp_stream.stream_output(words.data(), words.size()) == PICO_ERROR_NONE);
+
+	//every word reaches the latch in turn, port A then port B
+	REQUIRE(log.size() == 2 * words.size());
+	for (size_t i = 0; i < words.size(); i++) {
+		REQUIRE(log[2 * i + 1] == words[i]);
+	}
+	REQUIRE(chip.get_pin_levels() == words.back());
+
+	//4 chunks held together by repeated starts, IOCON written either side
+	REQUIRE(mock_bus_stats.transactions == 4 + 2);
+	REQUIRE(mock_bus_stats.repeated_starts == 3);
+	REQUIRE(mock_bus_stats.stops == 3);
+	REQUIRE(mock_bus_stats.bytes == 2 * words.size() + 4 + 2 * 2);
+	REQUIRE((chip.peek(MCP23017_IOCONA) & (1 << MCP23017_IOCON_SEQOP_BIT)) == 0);
+
+	//the output state follows the stream so a flush has nothing to write
+	REQUIRE(mcp_stream.get_output_bits() == words.back());
+	reset_bus_stats();
+	REQUIRE(mcp_stream.flush_output() == PICO_ERROR_NONE);
+	REQUIRE(mock_bus_stats.transactions == 0);
+}
+
+TEST_CASE("Stream Output In Byte Mode", "[mcp23017_stream]") {
+	reset_for_test(&stream_i2c);
+	Mcp23017_simulator chip(&stream_i2c, 0x20);
+	Mcp23017 mcp_stream(&stream_i2c, 0x20);
+	Mcp23017_config config;
+	config.io_direction = 0x0000;
+	config.sequential = false;
+	REQUIRE(mcp_stream.apply(config) == PICO_ERROR_NONE);
+	std::vector<uint16_t> words = stream_words(8);
+
+	reset_bus_stats();
+	REQUIRE(mcp_stream.stream_output(words.data(), words.size()) == PICO_ERROR_NONE);
+
+	//byte mode was already configured, only the words are sent
+	REQUIRE(mock_bus_stats.transactions == 1);
+	REQUIRE(mock_bus_stats.bytes == 1 + 2 * words.size());
+	REQUIRE((chip.peek(MCP23017_IOCONA) & (1 << MCP23017_IOCON_SEQOP_BIT)) != 0);
+	REQUIRE(chip.peek_pair(MCP23017_OLATA) == words.back());
+}
+
+TEST_CASE("Stream Output Failure", "[mcp23017_stream]") {
+	reset_for_test(&stream_i2c);
+	Mcp23017_simulator chip(&stream_i2c, 0x20);
+	Mcp23017 mcp_stream(&stream_i2c, 0x20);
+	mcp_stream.set_io_direction(0x0000);
+	std::vector<uint16_t> words = stream_words(2 * MCP23017_STREAM_CHUNK_WORDS);
+
+	mock_queue_i2c_result(PICO_ERROR_NONE, 1); //IOCON
+	mock_queue_i2c_result(PICO_ERROR_GENERIC, 1); //first chunk
+	REQUIRE(mcp_stream.stream_output(words.data(), words.size()) == MCP23017_ERROR_NACK);
+
+	//stopped after the first chunk, sequential operation restored and the last word left to be flushed
+	REQUIRE((chip.peek(MCP23017_IOCONA) & (1 << MCP23017_IOCON_SEQOP_BIT)) == 0);
+	REQUIRE_FALSE(mcp_stream.is_register_valid(MCP23017_OLATA));
+	REQUIRE(mcp_stream.is_register_dirty(MCP23017_OLATB));
+	REQUIRE(mcp_stream.flush_output() == PICO_ERROR_NONE);
+	REQUIRE(chip.peek_pair(MCP23017_OLATA) == words.back());
+
+#ifdef STATS_MCP23017
+	Mcp23017_stats stats{};
+	REQUIRE(mcp_stream.get_stats(stats));
+	REQUIRE(stats.errors == 1);
+#endif
+}
+
+TEST_CASE("Stream Output Nothing", "[mcp23017_stream]") {
+	reset_for_test(&stream_i2c);
+	Mcp23017_simulator chip(&stream_i2c, 0x20);
+	Mcp23017 mcp_stream(&stream_i2c, 0x20);
+
+	REQUIRE(mcp_stream.stream_output(nullptr, 0) == PICO_ERROR_NONE);
+	REQUIRE(mock_bus_stats.transactions == 0);
+}
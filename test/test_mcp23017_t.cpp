@@ -0,0 +1,143 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+
+#include "mcp23017_t.h"
+#include "mcp23017_private.h"
+#include "mcp23017_simulator.h"
+
+static i2c_inst_t t_i2c{};
+
+static_assert(Mcp23017T<0x20>::register_address(Mcp23017_register::iodir, Mcp23017_port::b) == MCP23017_IODIRB);
+static_assert(Mcp23017T<0x20>::register_address(Mcp23017_register::iocon) == MCP23017_IOCONA);
+static_assert(Mcp23017T<0x20>::register_address(Mcp23017_register::olat, Mcp23017_port::b) == MCP23017_OLATB);
+static_assert(Mcp23017T<0x20, Mcp23017_bank::separate>::register_address(Mcp23017_register::gpio) == 0x09);
+static_assert(Mcp23017T<0x20, Mcp23017_bank::separate>::register_address(Mcp23017_register::iocon, Mcp23017_port::b) == 0x15);
+
+TEST_CASE("Template Setup Bank Separate", "[mcp23017_t]") {
+	reset_for_test(&t_i2c);
+	Mcp23017T<0x24, Mcp23017_bank::separate> mcp_t(&t_i2c);
+
+	REQUIRE(mcp_t.setup(true, false) == PICO_ERROR_NONE);
+	REQUIRE(lastAddress == 0x24);
+	REQUIRE(mock_write_data.size() == 4);
+	REQUIRE(mock_write_data[0] == 0x0b);
+	REQUIRE(mock_write_data[1] == 0b11000000);
+	REQUIRE(mock_write_data[2] == 0x05);
+	REQUIRE(mock_write_data[3] == 0b11000000);
+}
+
+TEST_CASE("Template Setup Already Bank Separate", "[mcp23017_t]") {
+	reset_for_test(&t_i2c);
+	Mcp23017_simulator chip(&t_i2c, 0x25);
+	Mcp23017T<0x25, Mcp23017_bank::separate> mcp_t(&t_i2c);
+
+	REQUIRE(mcp_t.setup(true, false) == PICO_ERROR_NONE);
+	REQUIRE(chip.peek(MCP23017_IOCONA) == 0b11000000);
+	//a second run finds the device in BANK=1 where 0x0B is unimplemented
+	REQUIRE(mcp_t.setup(false, true) == PICO_ERROR_NONE);
+	REQUIRE(chip.peek(MCP23017_IOCONA) == 0b10000010);
+}
+
+TEST_CASE("Template Port Output Bank Separate", "[mcp23017_t]") {
+	reset_for_test(&t_i2c);
+	Mcp23017T<0x20, Mcp23017_bank::separate> mcp_t(&t_i2c);
+
+	mcp_t.set_output<9>(true);
+	mcp_t.set_output<15>(true);
+	mcp_t.set_output<15>(false);
+	REQUIRE(mcp_t.get_output<9>());
+	REQUIRE(!mcp_t.get_output<15>());
+	REQUIRE(mcp_t.flush_port_output<Mcp23017_port::b>() == PICO_ERROR_NONE);
+	REQUIRE(mock_write_data.size() == 2);
+	REQUIRE(mock_write_data[0] == 0x1a);
+	REQUIRE(mock_write_data[1] == 0b10);
+
+	reset_for_test(&t_i2c);
+	REQUIRE(mcp_t.flush_output() == PICO_ERROR_NONE);
+	REQUIRE(mock_stop_count == 2);
+	REQUIRE(mock_write_data[0] == 0x0a);
+	REQUIRE(mock_write_data[2] == 0x1a);
+}
+
+TEST_CASE("Template Inputs Bank Paired", "[mcp23017_t]") {
+	reset_for_test(&t_i2c);
+	Mcp23017T<0x20> mcp_t(&t_i2c);
+	std::vector<uint8_t> data = {0b00000001, 0b10000000};
+	set_read_data(data, 2);
+
+	REQUIRE(mcp_t.update_input_values() == PICO_ERROR_NONE);
+	REQUIRE(mock_write_data.size() == 1);
+	REQUIRE(mock_write_data[0] == MCP23017_GPIOA);
+	REQUIRE(mcp_t.get_input<0>());
+	REQUIRE(!mcp_t.get_input<1>());
+	REQUIRE(mcp_t.get_input<15>());
+	REQUIRE(mcp_t.get_input_values() == 0x8001);
+}
+
+TEST_CASE("Template Inputs Bank Separate", "[mcp23017_t]") {
+	reset_for_test(&t_i2c);
+	Mcp23017T<0x20, Mcp23017_bank::separate> mcp_t(&t_i2c);
+	std::vector<uint8_t> data = {0x12, 0x34};
+	set_read_data(data, 2);
+
+	REQUIRE(mcp_t.update_port_input_values<Mcp23017_port::b>() == 0x12);
+	REQUIRE(mcp_t.get_input_values() == 0x1200);
+	REQUIRE(mcp_t.update_port_input_values<Mcp23017_port::a>() == 0x34);
+	REQUIRE(mcp_t.get_input_values() == 0x1234);
+	REQUIRE(mock_write_data[0] == 0x19);
+	REQUIRE(mock_write_data[1] == 0x09);
+}
+
+TEST_CASE("Template Io Policy", "[mcp23017_t]") {
+	reset_for_test(&t_i2c);
+	Mcp23017_simulator chip(&t_i2c, 0x20);
+	Mcp23017T<0x20> mcp_t(&t_i2c);
+
+	REQUIRE(mcp_t.set_io_direction(static_cast<uint16_t>(0x0000)) == PICO_ERROR_NONE);
+	REQUIRE(mock_last_timeout_us == MCP23017_DEFAULT_TIMEOUT_US);
+
+	mock_queue_i2c_result(PICO_ERROR_TIMEOUT, 1);
+	REQUIRE(mcp_t.update_input_values() == MCP23017_ERROR_TIMEOUT);
+	mock_queue_i2c_result(PICO_ERROR_GENERIC, 1);
+	REQUIRE(mcp_t.update_port_input_values<Mcp23017_port::b>() == MCP23017_ERROR_NACK);
+
+	Mcp23017_io_policy policy;
+	policy.timeout_us = 500;
+	policy.retries = 2;
+	policy.backoff_us = 100;
+	mcp_t.set_io_policy(policy);
+	REQUIRE(mcp_t.get_io_policy().retries == 2);
+	mcp_t.set_outputs(0x1234);
+	mock_time_us = 0;
+	mock_queue_i2c_result(PICO_ERROR_TIMEOUT, 2);
+	REQUIRE(mcp_t.flush_output() == PICO_ERROR_NONE);
+	REQUIRE(mock_last_timeout_us == 500);
+	REQUIRE(mock_time_us == 500 + 100 + 500 + 200);
+	REQUIRE(chip.peek_pair(MCP23017_OLATA) == 0x1234);
+#ifdef STATS_MCP23017
+	Mcp23017_stats stats{};
+	REQUIRE(mcp_t.get_stats(stats));
+	REQUIRE(stats.retries == 2);
+	REQUIRE(stats.errors == 2);
+	REQUIRE(stats.transactions == 6);
+#endif
+}
+
+TEST_CASE("Template Through A Transport", "[mcp23017_t]") {
+	reset_for_test(&t_i2c);
+	Mcp23017_simulator chip(&t_i2c, 0x21);
+	Mcp23017_pico_transport transport(&t_i2c);
+	Mcp23017T<0x21, Mcp23017_bank::separate> mcp_t(transport);
+	REQUIRE(&mcp_t.get_transport() == &transport);
+
+	REQUIRE(mcp_t.setup(false, false) == PICO_ERROR_NONE);
+	chip.set_input_levels(0xa55a);
+	REQUIRE(mcp_t.update_input_values() == PICO_ERROR_NONE);
+	REQUIRE(mcp_t.get_input_values() == 0xa55a);
+}
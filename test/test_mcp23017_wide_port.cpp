@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2021, Adam Boardman
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "mcp23017.h"
+#include "mcp23017_private.h"
+#include "mcp23017_simulator.h"
+#include "mcp23017_wide_port.h"
+
+static i2c_inst_t wide_i2c0{};
+static i2c_inst_t wide_i2c1{};
+
+TEST_CASE("Wide Port Commits Only Changed Devices", "[mcp23017_wide_port]") {
+	reset_for_test(&wide_i2c0);
+	Mcp23017_simulator chip0(&wide_i2c0, 0x20);
+	Mcp23017_simulator chip1(&wide_i2c0, 0x21);
+	Mcp23017_simulator chip2(&wide_i2c0, 0x22);
+	Mcp23017_simulator chip3(&wide_i2c0, 0x23);
+	Mcp23017 mcp0(&wide_i2c0, 0x20);
+	Mcp23017 mcp1(&wide_i2c0, 0x21);
+	Mcp23017 mcp2(&wide_i2c0, 0x22);
+	Mcp23017 mcp3(&wide_i2c0, 0x23);
+	Mcp23017_wide_port<uint64_t> port(mcp0, mcp1, mcp2, mcp3);
+	REQUIRE(port.device_count == 4);
+
+	REQUIRE(port.commit() == PICO_ERROR_NONE);
+	REQUIRE(mock_bus_stats.transactions == 4);
+	REQUIRE(port.get_changed_devices() == 0);
+
+	reset_bus_stats();
+	port.write(0x00ff00000000ff00, 0x0012000000003400);
+	REQUIRE(port.get_output() == 0x0012000000003400);
+	REQUIRE(port.get_changed_devices() == 0b1001);
+	REQUIRE(port.commit() == PICO_ERROR_NONE);
+	REQUIRE(mock_bus_stats.transactions == 2);
+	REQUIRE(mock_bus_stats.bytes == 4); //one port each
+	REQUIRE(chip0.peek_pair(MCP23017_OLATA) == 0x3400);
+	REQUIRE(chip3.peek_pair(MCP23017_OLATA) == 0x0012);
+
+	reset_bus_stats();
+	port.write(0x0000ffff00000000, 0);
+	REQUIRE(port.commit() == PICO_ERROR_NONE);
+	REQUIRE(mock_bus_stats.transactions == 0);
+
+	port.set_bits(0x0000000100000000);
+	port.clear_bits(0x0002000000000000);
+	port.toggle_bits(0x8000000000000001);
+	REQUIRE(port.get_output() == 0x8010000100003401);
+	REQUIRE(port.commit() == PICO_ERROR_NONE);
+	REQUIRE(chip2.peek_pair(MCP23017_OLATA) == 0x0001);
+	REQUIRE(chip3.peek_pair(MCP23017_OLATA) == 0x8010);
+	REQUIRE(chip1.peek_pair(MCP23017_OLATA) == 0x0000);
+}
+
+TEST_CASE("Wide Port Across Buses", "[mcp23017_wide_port]") {
+	reset_for_test(&wide_i2c0);
+	Mcp23017_simulator chip0(&wide_i2c0, 0x20);
+	Mcp23017_simulator chip1(&wide_i2c1, 0x20);
+	Mcp23017_simulator chip2(&wide_i2c0, 0x21);
+	Mcp23017_simulator chip3(&wide_i2c1, 0x21);
+	Mcp23017 mcp0(&wide_i2c0, 0x20);
+	Mcp23017 mcp1(&wide_i2c1, 0x20);
+	Mcp23017 mcp2(&wide_i2c0, 0x21);
+	Mcp23017 mcp3(&wide_i2c1, 0x21);
+	Mcp23017_wide_port<uint64_t> port(mcp0, mcp1, mcp2, mcp3);
+
+	port.write(0x0004000300020001);
+	REQUIRE(port.commit() == PICO_ERROR_NONE);
+	REQUIRE(chip0.peek_pair(MCP23017_OLATA) == 0x0001);
+	REQUIRE(chip1.peek_pair(MCP23017_OLATA) == 0x0002);
+	REQUIRE(chip2.peek_pair(MCP23017_OLATA) == 0x0003);
+	REQUIRE(chip3.peek_pair(MCP23017_OLATA) == 0x0004);
+	REQUIRE(lastAddress == 0x21); //bus 0 devices first, then bus 1
+
+	chip1.set_input_levels(0xbeef);
+	chip2.set_input_levels(0xf00d);
+	mcp1.set_io_direction(0xffff);
+	mcp2.set_io_direction(0xffff);
+	REQUIRE(port.update_inputs() == PICO_ERROR_NONE);
+	REQUIRE(port.read() == 0x0000f00dbeef0000);
+	REQUIRE(port.read(0x00000000ffff0000) == 0x00000000beef0000);
+}
+
+TEST_CASE("Wide Port Groups Transports By Bus", "[mcp23017_wide_port]") {
+	reset_for_test(&wide_i2c0);
+	Mcp23017_pico_transport transport0(&wide_i2c0);
+	Mcp23017_pico_transport transport1(&wide_i2c1);
+	Mcp23017_simulator chip0(&wide_i2c0, 0x20);
+	Mcp23017_simulator chip1(&wide_i2c1, 0x21);
+	Mcp23017_simulator chip2(&wide_i2c1, 0x22);
+	Mcp23017_simulator chip3(&wide_i2c0, 0x23);
+	Mcp23017 mcp0(transport0, 0x20);
+	Mcp23017 mcp1(transport1, 0x21);
+	Mcp23017 mcp2(transport1, 0x22);
+	Mcp23017 mcp3(transport0, 0x23);
+	Mcp23017_wide_port<uint64_t> port(mcp0, mcp1, mcp2, mcp3);
+
+	port.write(0x0004000300020001);
+	REQUIRE(port.commit() == PICO_ERROR_NONE);
+	REQUIRE(chip3.peek_pair(MCP23017_OLATA) == 0x0004);
+	REQUIRE(lastAddress == 0x22); //0x20 and 0x23 on bus 0, then 0x21 and 0x22 on bus 1
+}
+
+TEST_CASE("Wide Port Retries Failed Devices", "[mcp23017_wide_port]") {
+	reset_for_test(&wide_i2c0);
+	Mcp23017_simulator chip0(&wide_i2c0, 0x20);
+	Mcp23017_simulator chip1(&wide_i2c0, 0x21);
+	Mcp23017 mcp0(&wide_i2c0, 0x20);
+	Mcp23017 mcp1(&wide_i2c0, 0x21);
+	Mcp23017_wide_port<uint32_t> port(mcp0, mcp1);
+	port.commit();
+
+	port.write(0x00010001);
+	mock_queue_i2c_result(PICO_ERROR_GENERIC, 1);
+	REQUIRE(port.commit() == PICO_ERROR_GENERIC);
+	REQUIRE(port.get_changed_devices() == 0b01);
+	REQUIRE(chip1.peek_pair(MCP23017_OLATA) == 0x0001);
+	REQUIRE(port.commit() == PICO_ERROR_NONE);
+	REQUIRE(chip0.peek_pair(MCP23017_OLATA) == 0x0001);
+}
+
+TEST_CASE("Wide Port 128 Bits", "[mcp23017_wide_port]") {
+	reset_for_test(&wide_i2c0);
+	Mcp23017 mcp[8] = {
+			{&wide_i2c0, 0x20}, {&wide_i2c0, 0x21}, {&wide_i2c0, 0x22}, {&wide_i2c0, 0x23},
+			{&wide_i2c0, 0x24}, {&wide_i2c0, 0x25}, {&wide_i2c0, 0x26}, {&wide_i2c0, 0x27},
+	};
+	Mcp23017_wide_port<unsigned __int128> port(mcp[0], mcp[1], mcp[2], mcp[3], mcp[4], mcp[5], mcp[6], mcp[7]);
+	unsigned __int128 top = static_cast<unsigned __int128>(0x8001) << 112;
+	port.write(top | 1);
+	REQUIRE(port.get_output() == (top | 1));
+	REQUIRE(mcp[7].get_output_bits() == 0x8001);
+	REQUIRE(mcp[0].get_output_bits() == 0x0001);
+}